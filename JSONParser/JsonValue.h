@@ -12,27 +12,144 @@
 #include <variant>
 #include <optional>
 #include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <cstdint>
+#include "result.hpp"
 
 namespace JSONParser {
 
 constexpr bool shouldPrintValueTypes = false;
 
+// Hash of an object key, usable in constant expressions. FNV-1a style, but mixing in 8 bytes at a time.
+constexpr size_t hashKey(std::string_view key) noexcept {
+    constexpr uint64_t prime = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull ^ key.size();
+    for (size_t i = 0; i < key.size(); i += 8) {
+        uint64_t word = 0;
+        for (size_t j = i; j < key.size() && j < i + 8; ++j) {
+            word |= uint64_t(static_cast<unsigned char>(key[j])) << (8 * (j - i));
+        }
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 32;
+    }
+    return static_cast<size_t>(hash);
+}
+
+// Object key with its hash computed once, for lookups repeated on many objects. Refers to the name
+// instead of copying it, so the name has to outlive the key, e.g.
+//     static constexpr JSONKey ageKey("age");
+class JSONKey {
+    std::string_view name_;
+    size_t hash_;
+public:
+    constexpr explicit JSONKey(std::string_view name) noexcept: name_(name), hash_(hashKey(name)) {}
+    constexpr explicit JSONKey(const char* name) noexcept: JSONKey(std::string_view(name)) {}
+    
+    constexpr std::string_view name() const noexcept { return name_; }
+    constexpr size_t hash() const noexcept { return hash_; }
+};
+
+// Name of an object member, stored with its hash so it is only hashed once. Lookups instead wrap the
+// name they look for in a key referring to it, so finding a member never copies the name, and never
+// hashes it either when looking up by JSONKey.
+class MemberKey: public std::string {
+    // Name looked up, if the key refers to it instead of holding it
+    std::string_view lookedUp_;
+    size_t hash_;
+    
+    MemberKey(std::string_view name, size_t hash) noexcept: lookedUp_(name), hash_(hash) {}
+public:
+    MemberKey(std::string name): std::string(std::move(name)), hash_(hashKey(*this)) {}
+    
+    // Refers to name, which has to outlive the key, e.g. while a lookup is made with it
+    static MemberKey referTo(std::string_view name, size_t hash) noexcept { return MemberKey(name, hash); }
+    
+    std::string_view name() const noexcept { return lookedUp_.data() != nullptr ? lookedUp_ : std::string_view(*this); }
+    size_t hash() const noexcept { return hash_; }
+};
+
+struct KeyHash {
+    size_t operator()(const MemberKey& key) const noexcept { return key.hash(); }
+};
+
+struct KeyEqual {
+    bool operator()(const MemberKey& lhs, const MemberKey& rhs) const noexcept { return lhs.name() == rhs.name(); }
+};
+
 template<typename TValue>
 class GenericObject {
-    std::unordered_map<std::string, TValue> members_;
+    using Map = std::unordered_map<MemberKey, TValue, KeyHash, KeyEqual>;
+    Map members_;
+    
+    typename Map::const_iterator find(std::string_view name, size_t hash) const {
+        return members_.find(MemberKey::referTo(name, hash));
+    }
+    
+    typename Map::iterator find(std::string_view name, size_t hash) {
+        return members_.find(MemberKey::referTo(name, hash));
+    }
 public:
+    using const_iterator = typename Map::const_iterator;
+    
     GenericObject() = default;
     
+    size_t size() const { return members_.size(); }
+    
+    void reserve(size_t size) { members_.reserve(size); }
+    
+    const_iterator begin() const { return members_.begin(); }
+    const_iterator end() const { return members_.end(); }
+    
     bool exists(const std::string& key) const {
-        return members_.find(key) != members_.end();
+        return find(key, hashKey(key)) != members_.end();
     }
     
     TValue getValue(const std::string& key) const {
-        return members_.at(key);
+        if (auto it = find(key, hashKey(key)); it != members_.end()) {
+            return it->second;
+        }
+        JSONPARSER_THROW(std::out_of_range("No member named " + key));
+    }
+    
+    TValue& getValue(const std::string& key) {
+        if (auto it = find(key, hashKey(key)); it != members_.end()) {
+            return it->second;
+        }
+        JSONPARSER_THROW(std::out_of_range("No member named " + key));
     }
     
     std::optional<TValue> getOptValue(const std::string& key) const {
-        if (auto it = members_.find(key); it != members_.end()) {
+        if (auto it = find(key, hashKey(key)); it != members_.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+    
+    // Lookups by JSONKey neither allocate nor hash the key
+    
+    bool exists(const JSONKey& key) const {
+        return find(key.name(), key.hash()) != members_.end();
+    }
+    
+    const TValue& getValue(const JSONKey& key) const {
+        if (auto it = find(key.name(), key.hash()); it != members_.end()) {
+            return it->second;
+        }
+        JSONPARSER_THROW(std::out_of_range("No member named " + std::string(key.name())));
+    }
+    
+    TValue& getValue(const JSONKey& key) {
+        if (auto it = find(key.name(), key.hash()); it != members_.end()) {
+            return it->second;
+        }
+        JSONPARSER_THROW(std::out_of_range("No member named " + std::string(key.name())));
+    }
+    
+    std::optional<TValue> getOptValue(const JSONKey& key) const {
+        if (auto it = find(key.name(), key.hash()); it != members_.end()) {
             return it->second;
         }
         return std::nullopt;
@@ -42,8 +159,12 @@ public:
         members_.insert_or_assign(key, value);
     }
     
+    void setMember(const std::string& key, TValue&& value) {
+        members_.insert_or_assign(key, std::move(value));
+    }
+    
     void removeMember(const std::string& key) {
-        members_.erase(key);
+        members_.erase(MemberKey::referTo(key, hashKey(key)));
     }
     
     friend std::ostream& operator<<(std::ostream& os, const GenericObject& object) {
@@ -60,10 +181,17 @@ template<typename TValue>
 class GenericArray {
     std::vector<TValue> members_;
 public:
+    using const_iterator = typename std::vector<TValue>::const_iterator;
+    
     GenericArray() = default;
     
     size_t size() const { return members_.size(); }
     
+    void reserve(size_t size) { members_.reserve(size); }
+    
+    const_iterator begin() const { return members_.begin(); }
+    const_iterator end() const { return members_.end(); }
+    
     TValue& operator[](size_t pos) { return members_[pos]; }
     const TValue& operator[](size_t pos) const { return members_[pos]; }
     
@@ -71,6 +199,10 @@ public:
         members_.push_back(value);
     }
     
+    void addMember(TValue&& value) {
+        members_.push_back(std::move(value));
+    }
+    
     void removeMember(const TValue& value) {
         members_.erase(value);
     }
@@ -85,6 +217,8 @@ public:
     }
 };
 
+// Const member functions never modify a value, so any number of threads may read the same JSONValue
+// concurrently, as long as no thread modifies it or anything below it meanwhile.
 class JSONValue {
     using Object = GenericObject<JSONValue>;
     using Array = GenericArray<JSONValue>;
@@ -98,6 +232,8 @@ public:
     JSONValue(const bool boolean): value_(boolean) {}
     JSONValue(const Object& object): value_(object) {}
     JSONValue(const Array& array): value_(array) {}
+    JSONValue(Object&& object): value_(std::move(object)) {}
+    JSONValue(Array&& array): value_(std::move(array)) {}
     
     bool isNull() const {  return value_.index() == 0; }
     bool isString() const {  return value_.index() == 1; }
@@ -113,6 +249,8 @@ public:
     bool getBool() const {  return std::get<bool>(value_); }
     const Object& getObject() const {  return std::get<Object>(value_); }
     const Array& getArray() const {  return std::get<Array>(value_); }
+    Object& getObject() {  return std::get<Object>(value_); }
+    Array& getArray() {  return std::get<Array>(value_); }
     
     std::optional<std::string> getOptString() const {
         if (isString()) return getString();
@@ -0,0 +1,395 @@
+//
+//  async_parser.hpp
+//  JSONParser
+//
+
+#ifndef async_parser_h
+#define async_parser_h
+
+#include "parser.hpp"
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace JSONParser {
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Builds values from tokens pushed one at a time, so parsing can pause whenever the input runs out.
+class ValueBuilder {
+    enum class Expect {
+        Value,
+        ValueOrEnd,
+        Key,
+        KeyOrEnd,
+        Colon,
+        CommaOrEnd
+    };
+
+    struct Frame {
+        JSONValue container;
+        std::string key;
+    };
+
+    Expect expect_ = Expect::Value;
+    std::vector<Frame> stack_;
+    std::optional<JSONValue> result_;
+
+    bool completeValue(JSONValue&& value) {
+        if (stack_.empty()) {
+            result_ = std::move(value);
+            expect_ = Expect::Value;
+            return true;
+        }
+        auto& frame = stack_.back();
+        if (frame.container.isObject()) {
+            frame.container.getObject().setMember(frame.key, std::move(value));
+        } else {
+            frame.container.getArray().addMember(std::move(value));
+        }
+        expect_ = Expect::CommaOrEnd;
+        return false;
+    }
+
+    bool closeContainer() {
+        auto container = std::move(stack_.back().container);
+        stack_.pop_back();
+        return completeValue(std::move(container));
+    }
+
+    static char specifierOf(const TokenView& token) {
+        return token.type == TokenType::JsonFormatSpecifier ? token.value[0] : '\0';
+    }
+public:
+    // Returns true once the token completes a top level value, which can then be taken
+    bool push(const TokenView& token) {
+        const char specifier = specifierOf(token);
+        switch (expect_) {
+            case Expect::KeyOrEnd:
+                if (specifier == rightBrace) {
+                    return closeContainer();
+                }
+                [[fallthrough]];
+            case Expect::Key:
+                if (token.type != TokenType::String) {
+                    throwError(ErrorCode::ExpectedKey);
+                }
+                stack_.back().key = std::string(token.value);
+                expect_ = Expect::Colon;
+                return false;
+            case Expect::Colon:
+                if (specifier != colon) {
+                    throwError(ErrorCode::ExpectedColon);
+                }
+                expect_ = Expect::Value;
+                return false;
+            case Expect::CommaOrEnd:
+                if (specifier == comma) {
+                    expect_ = stack_.back().container.isObject() ? Expect::Key : Expect::Value;
+                    return false;
+                }
+                if (specifier == (stack_.back().container.isObject() ? rightBrace : rightBracket)) {
+                    return closeContainer();
+                }
+                throwError(ErrorCode::MissingClosingBracket);
+            case Expect::ValueOrEnd:
+                if (specifier == rightBracket) {
+                    return closeContainer();
+                }
+                [[fallthrough]];
+            case Expect::Value:
+                if (specifier == leftBrace) {
+                    stack_.push_back(Frame{JSONValue(JSONObject()), std::string()});
+                    expect_ = Expect::KeyOrEnd;
+                    return false;
+                }
+                if (specifier == leftBracket) {
+                    stack_.push_back(Frame{JSONValue(JSONArray()), std::string()});
+                    expect_ = Expect::ValueOrEnd;
+                    return false;
+                }
+                JSONValue value;
+                if (const auto error = Parser::tryParsePrimitiveToken(token, value); error != ErrorCode::None) {
+                    throwError(error);
+                }
+                return completeValue(std::move(value));
+        }
+        return false;
+    }
+
+    // True while a top level value has been started but not completed
+    bool inProgress() const { return !stack_.empty(); }
+
+    JSONValue take() {
+        auto value = std::move(*result_);
+        result_.reset();
+        return value;
+    }
+};
+#pragma clang diagnostic pop
+
+}
+
+#if defined(__cpp_impl_coroutine) && defined(__cpp_concepts) && __has_include(<coroutine>)
+#define JSONPARSER_HAS_COROUTINES 1
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+
+namespace JSONParser {
+
+// Anything with a read(char* buffer, size_t size) returning an awaitable that yields the number of bytes
+// read into buffer, zero at the end of the input
+template<typename TReader>
+concept AsyncReader = requires(TReader& reader, char* buffer, size_t size) {
+    reader.read(buffer, size);
+};
+
+// Lazily started coroutine producing a T, resuming its awaiter when done
+template<typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().continuation;
+            }
+            void await_resume() noexcept {}
+        };
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        template<typename TValue>
+        void return_value(TValue&& returned) { value.emplace(std::forward<TValue>(returned)); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit Task(std::coroutine_handle<promise_type> handle): handle_(handle) {}
+public:
+    Task(Task&& other) noexcept: handle_(std::exchange(other.handle_, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    Task& operator=(Task&& other) noexcept {
+        std::swap(handle_, other.handle_);
+        return *this;
+    }
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle_.promise().continuation = awaiter;
+        return handle_;
+    }
+
+    T await_resume() {
+        auto& promise = handle_.promise();
+        if (promise.error) {
+            std::rethrow_exception(promise.error);
+        }
+        return std::move(*promise.value);
+    }
+};
+
+// Coroutine yielding a sequence of T, where producing each one may await. Consumers loop over
+// co_await generator.next() until it yields std::nullopt.
+template<typename T>
+class AsyncGenerator {
+public:
+    struct promise_type {
+        std::optional<T> current;
+        std::exception_ptr error;
+        std::coroutine_handle<> consumer = std::noop_coroutine();
+
+        struct ConsumerAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().consumer;
+            }
+            void await_resume() noexcept {}
+        };
+
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        ConsumerAwaiter final_suspend() noexcept { return {}; }
+        ConsumerAwaiter yield_value(T value) {
+            current.emplace(std::move(value));
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle): handle_(handle) {}
+public:
+    AsyncGenerator(AsyncGenerator&& other) noexcept: handle_(std::exchange(other.handle_, nullptr)) {}
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    AsyncGenerator& operator=(AsyncGenerator&& other) noexcept {
+        std::swap(handle_, other.handle_);
+        return *this;
+    }
+
+    ~AsyncGenerator() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    auto next() {
+        struct NextAwaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return handle.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+                handle.promise().consumer = consumer;
+                handle.promise().current.reset();
+                return handle;
+            }
+
+            std::optional<T> await_resume() {
+                auto& promise = handle.promise();
+                if (promise.error) {
+                    std::rethrow_exception(std::exchange(promise.error, nullptr));
+                }
+                return std::exchange(promise.current, std::nullopt);
+            }
+        };
+        return NextAwaiter{handle_};
+    }
+};
+
+// Parses one value, awaiting reader for more bytes whenever the buffered ones run out of complete tokens.
+// Malformed input throws from the awaiting coroutine, so without exceptions it aborts; see JSONPARSER_THROW.
+template<AsyncReader TReader>
+Task<JSONValue> asyncParse(TReader& reader, size_t chunkSize = 64 * 1024) {
+    TokenBuffer buffer(chunkSize);
+    ValueBuilder builder;
+    while (true) {
+        TokenView token;
+        if (!buffer.tryNext(token)) {
+            const auto [data, size] = buffer.prepareWrite();
+            buffer.commit(co_await reader.read(data, size));
+            continue;
+        }
+        if (token.type == TokenType::None) {
+            throwError(ErrorCode::UnexpectedEnd);
+        }
+        if (builder.push(token)) {
+            co_return builder.take();
+        }
+    }
+}
+
+// Yields every top level value of the input, e.g. NDJSON records, as soon as its last token arrives.
+// Like asyncParse, malformed input aborts without exceptions.
+template<AsyncReader TReader>
+AsyncGenerator<JSONValue> asyncRecords(TReader& reader, size_t chunkSize = 64 * 1024) {
+    TokenBuffer buffer(chunkSize);
+    ValueBuilder builder;
+    while (true) {
+        TokenView token;
+        if (!buffer.tryNext(token)) {
+            const auto [data, size] = buffer.prepareWrite();
+            buffer.commit(co_await reader.read(data, size));
+            continue;
+        }
+        if (token.type == TokenType::None) {
+            if (builder.inProgress()) {
+                throwError(ErrorCode::UnexpectedEnd);
+            }
+            co_return;
+        }
+        if (builder.push(token)) {
+            co_yield builder.take();
+        }
+    }
+}
+
+namespace Detail {
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+template<typename T>
+struct SyncWaitState {
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    std::optional<T> value;
+    std::exception_ptr error;
+};
+#pragma clang diagnostic pop
+
+// Starts right away and frees itself when done
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template<typename T>
+DetachedTask runAndNotify(Task<T>& task, SyncWaitState<T>& state) {
+    std::optional<T> value;
+    std::exception_ptr error;
+#if JSONPARSER_EXCEPTIONS
+    try {
+        value.emplace(co_await task);
+    } catch (...) {
+        error = std::current_exception();
+    }
+#else
+    value.emplace(co_await task);
+#endif
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.value = std::move(value);
+    state.error = error;
+    state.done = true;
+    state.finished.notify_all();
+}
+
+}
+
+// Blocks the calling thread until task completes, wherever the reads it awaits get resumed
+template<typename T>
+T syncWait(Task<T> task) {
+    Detail::SyncWaitState<T> state;
+    Detail::runAndNotify(task, state);
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.finished.wait(lock, [&state]() { return state.done; });
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+    return std::move(*state.value);
+}
+
+}
+
+#endif
+
+#endif /* async_parser_h */
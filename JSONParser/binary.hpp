@@ -0,0 +1,411 @@
+//
+//  binary.hpp
+//  JSONParser
+//
+
+#ifndef binary_h
+#define binary_h
+
+#include "JsonValue.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace JSONParser {
+
+// Binary layout, integers in native byte order and offsets absolute from the buffer start:
+//   header:            "JSB1", uint32 root offset
+//   null/false/true:   tag
+//   integer/double:    tag, 8 byte payload
+//   string:            tag, uint32 length, bytes
+//   array:             tag, uint32 count, count * uint32 value offsets
+//   object:            tag, uint32 count, count * uint32 key offsets, count * uint32 value offsets
+// Object keys are sorted and stored as uint32 length + bytes, so lookups are a binary search.
+constexpr char binaryMagic[] = {'J', 'S', 'B', '1'};
+constexpr size_t binaryHeaderSize = sizeof(binaryMagic) + sizeof(uint32_t);
+
+enum class BinaryTag : uint8_t {
+    Null,
+    False,
+    True,
+    Integer,
+    Double,
+    String,
+    Array,
+    Object
+};
+
+class BinaryEncoder {
+    static uint32_t currentOffset(const std::string& output) {
+        if (output.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Binary document exceeds 4 GiB");
+        }
+        return static_cast<uint32_t>(output.size());
+    }
+
+    static void appendTag(std::string& output, BinaryTag tag) {
+        output.push_back(static_cast<char>(tag));
+    }
+
+    template<typename T>
+    static void appendScalar(std::string& output, T value) {
+        output.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void patchOffset(std::string& output, size_t position, uint32_t offset) {
+        std::memcpy(&output[position], &offset, sizeof(offset));
+    }
+
+    static void appendString(std::string& output, const std::string& string) {
+        if (string.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("String exceeds 4 GiB");
+        }
+        appendScalar(output, static_cast<uint32_t>(string.size()));
+        output.append(string);
+    }
+
+    // Reserves a table of `count` offsets and returns its position
+    static size_t appendOffsetTable(std::string& output, size_t count) {
+        const auto tablePosition = output.size();
+        output.append(count * sizeof(uint32_t), '\0');
+        return tablePosition;
+    }
+
+    static uint32_t encodeObject(std::string& output, const JSONObject& object) {
+        std::vector<JSONObject::const_iterator> members;
+        members.reserve(object.size());
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            members.push_back(it);
+        }
+        std::sort(members.begin(), members.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs->first < rhs->first;
+        });
+
+        const auto offset = currentOffset(output);
+        appendTag(output, BinaryTag::Object);
+        appendScalar(output, static_cast<uint32_t>(members.size()));
+        const auto keyTable = appendOffsetTable(output, members.size());
+        const auto valueTable = appendOffsetTable(output, members.size());
+        for (size_t i = 0; i < members.size(); ++i) {
+            patchOffset(output, keyTable + i * sizeof(uint32_t), currentOffset(output));
+            appendString(output, members[i]->first);
+        }
+        for (size_t i = 0; i < members.size(); ++i) {
+            patchOffset(output, valueTable + i * sizeof(uint32_t), encodeValue(output, members[i]->second));
+        }
+        return offset;
+    }
+
+    static uint32_t encodeArray(std::string& output, const JSONArray& array) {
+        const auto offset = currentOffset(output);
+        appendTag(output, BinaryTag::Array);
+        appendScalar(output, static_cast<uint32_t>(array.size()));
+        const auto valueTable = appendOffsetTable(output, array.size());
+        for (size_t i = 0; i < array.size(); ++i) {
+            patchOffset(output, valueTable + i * sizeof(uint32_t), encodeValue(output, array[i]));
+        }
+        return offset;
+    }
+
+    static uint32_t encodeValue(std::string& output, const JSONValue& value) {
+        if (value.isObject()) {
+            return encodeObject(output, value.getObject());
+        }
+        if (value.isArray()) {
+            return encodeArray(output, value.getArray());
+        }
+        const auto offset = currentOffset(output);
+        if (value.isNull()) {
+            appendTag(output, BinaryTag::Null);
+        } else if (value.isBool()) {
+            appendTag(output, value.getBool() ? BinaryTag::True : BinaryTag::False);
+        } else if (value.isInteger()) {
+            appendTag(output, BinaryTag::Integer);
+            appendScalar(output, value.getInteger());
+        } else if (value.isDouble()) {
+            appendTag(output, BinaryTag::Double);
+            appendScalar(output, value.getDouble());
+        } else if (value.isString()) {
+            appendTag(output, BinaryTag::String);
+            appendString(output, value.getString());
+        }
+        return offset;
+    }
+
+    template<typename TEncodable, typename TEncodeFunction>
+    static std::string encodeDocument(const TEncodable& root, TEncodeFunction encodeFunction) {
+        std::string output(binaryMagic, sizeof(binaryMagic));
+        appendScalar(output, uint32_t(0));
+        patchOffset(output, sizeof(binaryMagic), encodeFunction(output, root));
+        return output;
+    }
+public:
+    static std::string encode(const JSONValue& value) {
+        return encodeDocument(value, encodeValue);
+    }
+
+    static std::string encode(const JSONObject& object) {
+        return encodeDocument(object, encodeObject);
+    }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Read-only view of a value inside an encoded buffer, accessed in place without decoding.
+// The buffer must outlive every BinaryValue created from it.
+class BinaryValue {
+    std::string_view buffer_;
+    uint32_t offset_;
+
+    BinaryValue(std::string_view buffer, uint32_t offset): buffer_(buffer), offset_(offset) {}
+
+    template<typename T>
+    T readScalar(size_t position) const {
+        if (position + sizeof(T) > buffer_.size()) {
+            throw std::out_of_range("Truncated binary document");
+        }
+        T value;
+        std::memcpy(&value, buffer_.data() + position, sizeof(T));
+        return value;
+    }
+
+    std::string_view readString(size_t position) const {
+        const auto length = readScalar<uint32_t>(position);
+        position += sizeof(uint32_t);
+        if (position + length > buffer_.size()) {
+            throw std::out_of_range("Truncated binary document");
+        }
+        return buffer_.substr(position, length);
+    }
+
+    BinaryTag tag() const {
+        if (offset_ >= buffer_.size()) {
+            throw std::out_of_range("Truncated binary document");
+        }
+        return static_cast<BinaryTag>(buffer_[offset_]);
+    }
+
+    void expectTag(BinaryTag expected, const char* message) const {
+        if (tag() != expected) {
+            throw std::invalid_argument(message);
+        }
+    }
+
+    // Position of the i-th entry of an offset table that starts right after tag and count
+    size_t tableEntry(size_t table, size_t i) const {
+        return offset_ + 1 + sizeof(uint32_t) + (table * size() + i) * sizeof(uint32_t);
+    }
+
+    std::string_view keyAtUnchecked(size_t pos) const {
+        return readString(readScalar<uint32_t>(tableEntry(0, pos)));
+    }
+
+    BinaryValue valueAtUnchecked(size_t pos, size_t table) const {
+        return BinaryValue(buffer_, readScalar<uint32_t>(tableEntry(table, pos)));
+    }
+public:
+    static BinaryValue root(std::string_view buffer) {
+        if (buffer.size() < binaryHeaderSize ||
+            std::memcmp(buffer.data(), binaryMagic, sizeof(binaryMagic)) != 0) {
+            throw std::invalid_argument("Not a binary JSON document");
+        }
+        uint32_t rootOffset;
+        std::memcpy(&rootOffset, buffer.data() + sizeof(binaryMagic), sizeof(rootOffset));
+        return BinaryValue(buffer, rootOffset);
+    }
+
+    bool isNull() const { return tag() == BinaryTag::Null; }
+    bool isString() const { return tag() == BinaryTag::String; }
+    bool isDouble() const { return tag() == BinaryTag::Double; }
+    bool isInteger() const { return tag() == BinaryTag::Integer; }
+    bool isBool() const { return tag() == BinaryTag::True || tag() == BinaryTag::False; }
+    bool isObject() const { return tag() == BinaryTag::Object; }
+    bool isArray() const { return tag() == BinaryTag::Array; }
+
+    std::string_view getString() const {
+        expectTag(BinaryTag::String, "Binary value is not a string");
+        return readString(offset_ + 1);
+    }
+
+    double getDouble() const {
+        expectTag(BinaryTag::Double, "Binary value is not a double");
+        return readScalar<double>(offset_ + 1);
+    }
+
+    uint64_t getInteger() const {
+        expectTag(BinaryTag::Integer, "Binary value is not an integer");
+        return readScalar<uint64_t>(offset_ + 1);
+    }
+
+    bool getBool() const {
+        if (!isBool()) {
+            throw std::invalid_argument("Binary value is not a bool");
+        }
+        return tag() == BinaryTag::True;
+    }
+
+    // Number of members of an array or object
+    size_t size() const {
+        if (!isArray() && !isObject()) {
+            throw std::invalid_argument("Binary value is not a container");
+        }
+        return readScalar<uint32_t>(offset_ + 1);
+    }
+
+    BinaryValue operator[](size_t pos) const {
+        expectTag(BinaryTag::Array, "Binary value is not an array");
+        if (pos >= size()) {
+            throw std::out_of_range("Binary array index out of range");
+        }
+        return valueAtUnchecked(pos, 0);
+    }
+
+    std::string_view keyAt(size_t pos) const {
+        expectTag(BinaryTag::Object, "Binary value is not an object");
+        if (pos >= size()) {
+            throw std::out_of_range("Binary object index out of range");
+        }
+        return keyAtUnchecked(pos);
+    }
+
+    BinaryValue valueAt(size_t pos) const {
+        expectTag(BinaryTag::Object, "Binary value is not an object");
+        if (pos >= size()) {
+            throw std::out_of_range("Binary object index out of range");
+        }
+        return valueAtUnchecked(pos, 1);
+    }
+
+    std::optional<BinaryValue> getOptValue(std::string_view key) const {
+        expectTag(BinaryTag::Object, "Binary value is not an object");
+        size_t low = 0, high = size();
+        while (low < high) {
+            const auto mid = low + (high - low) / 2;
+            const auto midKey = keyAtUnchecked(mid);
+            if (midKey == key) {
+                return valueAtUnchecked(mid, 1);
+            }
+            if (midKey < key) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool exists(std::string_view key) const {
+        return getOptValue(key).has_value();
+    }
+
+    BinaryValue getValue(std::string_view key) const {
+        if (auto value = getOptValue(key)) {
+            return *value;
+        }
+        throw std::out_of_range("Key not found in binary object");
+    }
+
+    // Decodes this value and everything below it into a JSONValue tree
+    JSONValue toJSONValue() const {
+        switch (tag()) {
+            case BinaryTag::Null:
+                return JSONValue();
+            case BinaryTag::False:
+                return JSONValue(false);
+            case BinaryTag::True:
+                return JSONValue(true);
+            case BinaryTag::Integer:
+                return JSONValue(getInteger());
+            case BinaryTag::Double:
+                return JSONValue(getDouble());
+            case BinaryTag::String:
+                return JSONValue(std::string(getString()));
+            case BinaryTag::Array: {
+                JSONArray array;
+                const auto count = size();
+                for (size_t i = 0; i < count; ++i) {
+                    array.addMember(valueAtUnchecked(i, 0).toJSONValue());
+                }
+                return JSONValue(array);
+            }
+            case BinaryTag::Object: {
+                JSONObject object;
+                const auto count = size();
+                for (size_t i = 0; i < count; ++i) {
+                    object.setMember(std::string(keyAtUnchecked(i)), valueAtUnchecked(i, 1).toJSONValue());
+                }
+                return JSONValue(object);
+            }
+        }
+        throw std::invalid_argument("Unknown tag in binary document");
+    }
+};
+#pragma clang diagnostic pop
+
+// Read-only memory mapping of a whole file, e.g. an encoded document to be read in place with BinaryValue::root.
+class MappedFile {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+        }
+        struct stat fileStat;
+        if (::fstat(fd, &fileStat) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Cannot stat " + path);
+        }
+        size_ = static_cast<size_t>(fileStat.st_size);
+        if (size_ > 0) {
+            void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            const int error = errno;
+            ::close(fd);
+            if (address == MAP_FAILED) {
+                throw std::system_error(error, std::generic_category(), "Cannot map " + path);
+            }
+            data_ = static_cast<const char*>(address);
+        } else {
+            ::close(fd);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept: data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    std::string_view data() const { return std::string_view(data_, size_); }
+};
+
+}
+
+#endif /* binary_h */
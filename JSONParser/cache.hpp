@@ -0,0 +1,191 @@
+//
+//  cache.hpp
+//  JSONParser
+//
+
+#ifndef cache_h
+#define cache_h
+
+#include "parser.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace JSONParser {
+
+// Fast non-cryptographic 64 bit hash, consuming the input 8 bytes at a time
+inline uint64_t hashBytes(const std::string_view bytes) noexcept {
+    constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    const auto mix = [](uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDull;
+        value ^= value >> 33;
+        return value;
+    };
+    uint64_t hash = bytes.size() * multiplier;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t)) {
+        uint64_t chunk;
+        std::memcpy(&chunk, bytes.data() + i, sizeof(chunk));
+        hash = (hash ^ mix(chunk)) * multiplier;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+    hash = (hash ^ mix(tail)) * multiplier;
+    return mix(hash);
+}
+
+// Approximate heap footprint of a value tree, including the value itself
+inline size_t estimateMemoryUsage(const JSONValue& value) {
+    size_t usage = sizeof(JSONValue);
+    if (value.isString()) {
+        usage += value.getString().capacity();
+    } else if (value.isObject()) {
+        for (const auto& [key, member] : value.getObject()) {
+            // hash node: next pointer, cached hash, key and a bucket slot
+            usage += 3 * sizeof(void*) + sizeof(std::string) + key.capacity() + estimateMemoryUsage(member);
+        }
+    } else if (value.isArray()) {
+        for (const auto& member : value.getArray()) {
+            usage += estimateMemoryUsage(member);
+        }
+    }
+    return usage;
+}
+
+struct ParseCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t memoryUsage;
+};
+
+// Content-addressed cache in front of Parser::parse. Identical inputs share one immutable parsed document.
+// Inputs are keyed by hashBytes and compared byte for byte on a hit. Each of the shards has its own lock
+// and LRU list and gets an equal slice of the memory budget.
+class ParseCache {
+public:
+    using DocumentHandle = std::shared_ptr<const JSONObject>;
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string source;
+        DocumentHandle document;
+        size_t memoryUsage;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t memoryUsage = 0;
+    };
+
+    const size_t numShards_;
+    const size_t shardBudget_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+    // Caller must hold shard.mutex
+    static void erase(Shard& shard, std::list<Entry>::iterator entry) {
+        shard.memoryUsage -= entry->memoryUsage;
+        shard.index.erase(entry->hash);
+        shard.lru.erase(entry);
+    }
+public:
+    explicit ParseCache(size_t memoryBudget, size_t numShards = 16):
+        numShards_(std::max<size_t>(numShards, 1)),
+        shardBudget_(memoryBudget / std::max<size_t>(numShards, 1)),
+        shards_(new Shard[std::max<size_t>(numShards, 1)]) {}
+
+    ParseCache(const ParseCache&) = delete;
+    ParseCache& operator=(const ParseCache&) = delete;
+
+    // Parse errors are propagated and never cached
+    DocumentHandle parse(const std::string& inputString) {
+        const auto hash = hashBytes(inputString);
+        auto& shard = shards_[hash % numShards_];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (auto it = shard.index.find(hash); it != shard.index.end() && it->second->source == inputString) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return it->second->document;
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+
+        // Parse outside the lock so that other lookups in the shard are not blocked
+        auto document = std::make_shared<const JSONObject>(Parser::parse(inputString));
+        const auto memoryUsage = sizeof(Entry) + inputString.size() + estimateMemoryUsage(*document);
+        if (memoryUsage > shardBudget_) {
+            return document;
+        }
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (auto it = shard.index.find(hash); it != shard.index.end()) {
+            if (it->second->source == inputString) {
+                // Another thread parsed the same input meanwhile, hand out the shared copy
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                return it->second->document;
+            }
+            erase(shard, it->second);
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        shard.lru.push_front(Entry{hash, inputString, document, memoryUsage});
+        shard.index.emplace(hash, shard.lru.begin());
+        shard.memoryUsage += memoryUsage;
+        while (shard.memoryUsage > shardBudget_) {
+            erase(shard, std::prev(shard.lru.end()));
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return document;
+    }
+
+    // Whether inputString is cached, without counting a hit or refreshing its recency
+    bool contains(const std::string& inputString) {
+        const auto hash = hashBytes(inputString);
+        auto& shard = shards_[hash % numShards_];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto it = shard.index.find(hash);
+        return it != shard.index.end() && it->second->source == inputString;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < numShards_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            shards_[i].lru.clear();
+            shards_[i].index.clear();
+            shards_[i].memoryUsage = 0;
+        }
+    }
+
+    ParseCacheStats stats() {
+        ParseCacheStats cacheStats{
+            hits_.load(std::memory_order_relaxed),
+            misses_.load(std::memory_order_relaxed),
+            evictions_.load(std::memory_order_relaxed),
+            0,
+            0
+        };
+        for (size_t i = 0; i < numShards_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            cacheStats.entries += shards_[i].lru.size();
+            cacheStats.memoryUsage += shards_[i].memoryUsage;
+        }
+        return cacheStats;
+    }
+};
+
+}
+
+#endif /* cache_h */
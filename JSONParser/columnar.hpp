@@ -0,0 +1,382 @@
+//
+//  columnar.hpp
+//  JSONParser
+//
+
+#ifndef columnar_h
+#define columnar_h
+
+#include "parser.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace JSONParser {
+
+enum class ColumnType {
+    Int64,
+    Double,
+    Bool,
+    String
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Field to extract, e.g. "age" or "location.lat" for a member of a nested object
+struct ColumnSpec {
+    std::string path;
+    ColumnType type;
+};
+#pragma clang diagnostic pop
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Contiguous values of one field across records, laid out like an Arrow array. Validity and bool values
+// are bitmaps with one bit per row, least significant bit first. Strings are stored back to back in
+// stringData, row i spanning [stringOffsets[i], stringOffsets[i + 1]). Null rows hold zero or empty values.
+class Column {
+    friend class ColumnarExtractor;
+
+    std::string path_;
+    ColumnType type_;
+    size_t size_ = 0;
+    size_t nullCount_ = 0;
+    std::vector<uint8_t> validity_;
+    std::vector<int64_t> int64Values_;
+    std::vector<double> doubleValues_;
+    std::vector<uint8_t> boolValues_;
+    std::vector<uint64_t> stringOffsets_{0};
+    std::string stringData_;
+
+    static bool bitAt(const std::vector<uint8_t>& bitmap, size_t i) {
+        return (bitmap[i / 8] >> (i % 8)) & 1;
+    }
+
+    static void setBit(std::vector<uint8_t>& bitmap, size_t i, bool bit) {
+        if (i % 8 == 0) {
+            bitmap.push_back(0);
+        }
+        bitmap[i / 8] = static_cast<uint8_t>(bitmap[i / 8] | (bit << (i % 8)));
+    }
+
+    static void clearBit(std::vector<uint8_t>& bitmap, size_t i) {
+        bitmap[i / 8] = static_cast<uint8_t>(bitmap[i / 8] & ~(1 << (i % 8)));
+        if (i % 8 == 0) {
+            bitmap.pop_back();
+        }
+    }
+
+    // Every append writes the value slot, then the validity bit
+    void appendValidity(bool valid) {
+        setBit(validity_, size_, valid);
+        nullCount_ += !valid;
+        ++size_;
+    }
+
+    void appendNull() {
+        switch (type_) {
+            case ColumnType::Int64: int64Values_.push_back(0); break;
+            case ColumnType::Double: doubleValues_.push_back(0); break;
+            case ColumnType::Bool: setBit(boolValues_, size_, false); break;
+            case ColumnType::String: stringOffsets_.push_back(stringData_.size()); break;
+        }
+        appendValidity(false);
+    }
+
+    void appendInt64(int64_t value) {
+        int64Values_.push_back(value);
+        appendValidity(true);
+    }
+
+    void appendDouble(double value) {
+        doubleValues_.push_back(value);
+        appendValidity(true);
+    }
+
+    void appendBool(bool value) {
+        setBit(boolValues_, size_, value);
+        appendValidity(true);
+    }
+
+    void appendString(std::string_view value) {
+        stringData_.append(value);
+        stringOffsets_.push_back(stringData_.size());
+        appendValidity(true);
+    }
+
+    // Drops the last row, for records repeating a key where the last value wins
+    void removeLast() {
+        --size_;
+        nullCount_ -= !bitAt(validity_, size_);
+        clearBit(validity_, size_);
+        switch (type_) {
+            case ColumnType::Int64: int64Values_.pop_back(); break;
+            case ColumnType::Double: doubleValues_.pop_back(); break;
+            case ColumnType::Bool: clearBit(boolValues_, size_); break;
+            case ColumnType::String:
+                stringOffsets_.pop_back();
+                stringData_.resize(stringOffsets_.back());
+                break;
+        }
+    }
+public:
+    Column(std::string path, ColumnType type): path_(std::move(path)), type_(type) {}
+
+    const std::string& path() const { return path_; }
+    ColumnType type() const { return type_; }
+    size_t size() const { return size_; }
+    size_t nullCount() const { return nullCount_; }
+
+    bool isValid(size_t row) const { return bitAt(validity_, row); }
+    const std::vector<uint8_t>& validityBitmap() const { return validity_; }
+
+    const std::vector<int64_t>& int64Values() const { return int64Values_; }
+    const std::vector<double>& doubleValues() const { return doubleValues_; }
+    const std::vector<uint8_t>& boolBitmap() const { return boolValues_; }
+    const std::vector<uint64_t>& stringOffsets() const { return stringOffsets_; }
+    const std::string& stringData() const { return stringData_; }
+
+    bool boolValue(size_t row) const { return bitAt(boolValues_, row); }
+
+    // Raw text of the string, escape sequences are kept as is like everywhere else in the parser
+    std::string_view stringValue(size_t row) const {
+        return std::string_view(stringData_).substr(stringOffsets_[row], stringOffsets_[row + 1] - stringOffsets_[row]);
+    }
+};
+#pragma clang diagnostic pop
+
+// Fills typed columns from a stream of record objects, e.g. NDJSON, in a single pass over the tokens.
+// Members not asked for, including whole nested objects and arrays, are skipped without building any
+// values, though their syntax is checked like Parser::parse does. Missing fields, nulls and values of
+// another type, including objects and arrays, become null rows; integers are widened for double
+// columns. Numbers filling a column are rejected when out of range, like Parser::parse does.
+class ColumnarExtractor {
+    // Trie of the requested paths, one node per path segment
+    struct PathNode {
+        std::vector<std::pair<std::string, size_t>> children;
+        // Column filled by the value at this path, if any
+        size_t column = noColumn;
+    };
+
+    static constexpr size_t noColumn = static_cast<size_t>(-1);
+
+    std::vector<PathNode> nodes_;
+    std::vector<Column> columns_;
+    size_t numRows_ = 0;
+    std::string_view input_;
+    // Opening brackets of the containers being skipped, kept to reuse the allocation
+    std::vector<char> openContainers_;
+
+    // Drops the values extracted for a row that is left before the row is complete, e.g. by a syntax error
+    class PartialRowGuard {
+        ColumnarExtractor& extractor_;
+    public:
+        explicit PartialRowGuard(ColumnarExtractor& extractor): extractor_(extractor) {}
+
+        ~PartialRowGuard() {
+            for (auto& column : extractor_.columns_) {
+                if (column.size_ > extractor_.numRows_) {
+                    column.removeLast();
+                }
+            }
+        }
+    };
+
+    size_t childOf(size_t node, std::string_view key) const {
+        for (const auto& [childKey, child] : nodes_[node].children) {
+            if (childKey == key) {
+                return child;
+            }
+        }
+        return noColumn;
+    }
+
+    // Checks the key of an object member starting with token and the colon after it, and returns the
+    // token starting the member's value
+    TokenView memberValue(const TokenView& token) {
+        if (token.type != TokenType::String) {
+            throwError(ErrorCode::ExpectedKey);
+        }
+        if (!isSpecifier(Lexer::nextToken(input_), colon)) {
+            throwError(ErrorCode::ExpectedColon);
+        }
+        return Lexer::nextToken(input_);
+    }
+
+    // Skips the value starting with token, checking its syntax like Parser without building it. Open
+    // containers are kept on a stack of their opening brackets instead of recursing.
+    void skipValue(TokenView token) {
+        openContainers_.clear();
+        while (true) {
+            if (isSpecifier(token, leftBrace) || isSpecifier(token, leftBracket)) {
+                const auto opening = token.value[0];
+                token = Lexer::nextToken(input_);
+                if (!isSpecifier(token, opening == leftBrace ? rightBrace : rightBracket)) {
+                    openContainers_.push_back(opening);
+                    token = (opening == leftBrace) ? memberValue(token) : token;
+                    continue;
+                }
+            } else if (token.type == TokenType::JsonFormatSpecifier) {
+                throwError(ErrorCode::ExpectedValue);
+            }
+            // A value is complete; close the containers it completes and move on to the next value
+            while (true) {
+                if (openContainers_.empty()) {
+                    return;
+                }
+                const bool inObject = (openContainers_.back() == leftBrace);
+                token = Lexer::nextToken(input_);
+                if (isSpecifier(token, inObject ? rightBrace : rightBracket)) {
+                    openContainers_.pop_back();
+                    continue;
+                }
+                if (!isSpecifier(token, comma)) {
+                    throwError(ErrorCode::MissingClosingBracket);
+                }
+                token = Lexer::nextToken(input_);
+                token = inObject ? memberValue(token) : token;
+                break;
+            }
+        }
+    }
+
+    void fill(Column& column, const TokenView& token) {
+        if (column.size_ > numRows_) {
+            column.removeLast();
+        }
+        switch (column.type_) {
+            case ColumnType::Int64:
+                if (token.type == TokenType::Int) {
+                    // Integers are parsed as signed and stored as unsigned
+                    column.appendInt64(static_cast<int64_t>(Parser::parsePrimitiveToken(token).getInteger()));
+                    return;
+                }
+                break;
+            case ColumnType::Double:
+                if (token.type == TokenType::Int || token.type == TokenType::Double) {
+                    const auto number = Parser::parsePrimitiveToken(token);
+                    column.appendDouble(number.isDouble() ? number.getDouble() : static_cast<double>(static_cast<int64_t>(number.getInteger())));
+                    return;
+                }
+                break;
+            case ColumnType::Bool:
+                if (token.type == TokenType::Bool) {
+                    column.appendBool(token.value == trueString);
+                    return;
+                }
+                break;
+            case ColumnType::String:
+                if (token.type == TokenType::String) {
+                    column.appendString(token.value);
+                    return;
+                }
+                break;
+        }
+        column.appendNull();
+    }
+
+    void extractValue(const TokenView& token, size_t node) {
+        const bool isObject = isSpecifier(token, leftBrace);
+        if (token.type == TokenType::JsonFormatSpecifier && !isObject && !isSpecifier(token, leftBracket)) {
+            throwError(ErrorCode::ExpectedValue);
+        }
+        if (nodes_[node].column != noColumn) {
+            fill(columns_[nodes_[node].column], token);
+        }
+        if (isObject && !nodes_[node].children.empty()) {
+            extractObject(node);
+        } else if (isObject || isSpecifier(token, leftBracket)) {
+            skipValue(token);
+        }
+    }
+
+    // Called after the opening brace
+    void extractObject(size_t node) {
+        auto token = Lexer::nextToken(input_);
+        if (isSpecifier(token, rightBrace)) {
+            return;
+        }
+        while (true) {
+            const auto child = childOf(node, token.value);
+            const auto value = memberValue(token);
+            if (child != noColumn) {
+                extractValue(value, child);
+            } else {
+                skipValue(value);
+            }
+            token = Lexer::nextToken(input_);
+            if (isSpecifier(token, rightBrace)) {
+                return;
+            }
+            if (!isSpecifier(token, comma)) {
+                throwError(ErrorCode::MissingClosingBracket);
+            }
+            token = Lexer::nextToken(input_);
+        }
+    }
+public:
+    explicit ColumnarExtractor(const std::vector<ColumnSpec>& specs): nodes_(1) {
+        columns_.reserve(specs.size());
+        for (const auto& spec : specs) {
+            size_t node = 0;
+            std::string_view path = spec.path;
+            while (true) {
+                const auto segment = path.substr(0, path.find(dot));
+                auto child = childOf(node, segment);
+                if (child == noColumn) {
+                    child = nodes_.size();
+                    nodes_[node].children.emplace_back(std::string(segment), child);
+                    nodes_.emplace_back();
+                }
+                node = child;
+                if (segment.size() == path.size()) {
+                    break;
+                }
+                path.remove_prefix(segment.size() + 1);
+            }
+            if (nodes_[node].column != noColumn) {
+                JSONPARSER_THROW(std::invalid_argument("Duplicate column " + spec.path));
+            }
+            nodes_[node].column = columns_.size();
+            columns_.emplace_back(spec.path, spec.type);
+        }
+    }
+
+    // Appends a row per top level object in records, which may be separated by any whitespace, and
+    // returns the number of rows added. Rows appended before a syntax error are kept. Syntax errors
+    // throw, so without exceptions they abort; see JSONPARSER_THROW.
+    size_t append(std::string_view records) {
+        input_ = records;
+        const auto firstRow = numRows_;
+        while (true) {
+            const auto token = Lexer::takeToken(input_);
+            if (token.type == TokenType::None) {
+                break;
+            }
+            if (!isSpecifier(token, leftBrace)) {
+                throwError(ErrorCode::ExpectedObject);
+            }
+            const PartialRowGuard guard(*this);
+            extractObject(0);
+            ++numRows_;
+            for (auto& column : columns_) {
+                if (column.size_ < numRows_) {
+                    column.appendNull();
+                }
+            }
+        }
+        return numRows_ - firstRow;
+    }
+
+    size_t numRows() const { return numRows_; }
+
+    // Columns in the order of the specs
+    const std::vector<Column>& columns() const { return columns_; }
+    const Column& column(size_t i) const { return columns_[i]; }
+};
+
+}
+
+#endif /* columnar_h */
@@ -0,0 +1,230 @@
+//
+//  formatter.hpp
+//  JSONParser
+//
+
+#ifndef formatter_h
+#define formatter_h
+
+#include "lexer.hpp"
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <unistd.h>
+
+namespace JSONParser {
+
+// Token readers hand out one TokenView at a time through bool next(TokenView&), returning false at the
+// end of the input. A token stays valid only until the following call to next.
+
+class ViewTokenReader {
+    std::string_view input_;
+public:
+    explicit ViewTokenReader(std::string_view input): input_(input) {}
+
+    bool next(TokenView& token) {
+        size_t consumed;
+        token = Lexer::lexToken(input_, consumed);
+        input_.remove_prefix(consumed);
+        return token.type != TokenType::None;
+    }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Reads a file descriptor in chunks. Memory use is bounded by the chunk size, or the largest token if bigger.
+class FdTokenReader {
+    int fd_;
+    TokenBuffer buffer_;
+public:
+    explicit FdTokenReader(int fd, size_t chunkSize = 64 * 1024): fd_(fd), buffer_(chunkSize) {}
+
+    bool next(TokenView& token) {
+        while (!buffer_.tryNext(token)) {
+            const auto [data, size] = buffer_.prepareWrite();
+            ssize_t bytesRead;
+            do {
+                bytesRead = ::read(fd_, data, size);
+            } while (bytesRead < 0 && errno == EINTR);
+            if (bytesRead < 0) {
+                throw std::system_error(errno, std::generic_category(), "Cannot read input");
+            }
+            buffer_.commit(static_cast<size_t>(bytesRead));
+        }
+        return token.type != TokenType::None;
+    }
+};
+#pragma clang diagnostic pop
+
+// Sinks receive output through write(std::string_view)
+
+class StringSink {
+    std::string& output_;
+public:
+    explicit StringSink(std::string& output): output_(output) {}
+
+    void write(std::string_view text) { output_.append(text); }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Buffers output for a file descriptor. Call flush once done, since the destructor cannot report errors.
+class FdSink {
+    int fd_;
+    std::vector<char> buffer_;
+    size_t size_ = 0;
+public:
+    explicit FdSink(int fd, size_t bufferSize = 64 * 1024): fd_(fd), buffer_(std::max<size_t>(bufferSize, 1)) {}
+
+    FdSink(const FdSink&) = delete;
+    FdSink& operator=(const FdSink&) = delete;
+
+    ~FdSink() {
+        try {
+            flush();
+        } catch (const std::exception&) {
+        }
+    }
+
+    void write(std::string_view text) {
+        while (!text.empty()) {
+            if (size_ == buffer_.size()) {
+                flush();
+            }
+            const auto chunkSize = std::min(text.size(), buffer_.size() - size_);
+            std::copy(text.begin(), text.begin() + static_cast<std::ptrdiff_t>(chunkSize), buffer_.begin() + static_cast<std::ptrdiff_t>(size_));
+            size_ += chunkSize;
+            text.remove_prefix(chunkSize);
+        }
+    }
+
+    void flush() {
+        size_t written = 0;
+        while (written < size_) {
+            const auto result = ::write(fd_, buffer_.data() + written, size_ - written);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "Cannot write output");
+            }
+            written += static_cast<size_t>(result);
+        }
+        size_ = 0;
+    }
+};
+#pragma clang diagnostic pop
+
+enum class FormatStyle {
+    Minified,
+    Indented
+};
+
+// Rewrites JSON token by token straight from a token reader to a sink, without building values. Key order
+// and the text of strings and numbers are preserved. Top level values, e.g. NDJSON records, end up on
+// separate lines. Only bracket nesting is checked; use Validator for full checking.
+class Formatter {
+    template<typename TSink>
+    static void writeNewline(TSink& sink, size_t depth, size_t indentWidth) {
+        static constexpr std::string_view spaces = "\n                                ";
+        sink.write(spaces.substr(0, 1));
+        for (auto remaining = depth * indentWidth; remaining > 0;) {
+            const auto chunkSize = std::min(remaining, spaces.size() - 1);
+            sink.write(spaces.substr(1, chunkSize));
+            remaining -= chunkSize;
+        }
+    }
+
+    template<typename TSink>
+    static void writeToken(TSink& sink, const TokenView& token) {
+        if (token.type == TokenType::String) {
+            sink.write(std::string_view(&doubleQuote, 1));
+            sink.write(token.value);
+            sink.write(std::string_view(&doubleQuote, 1));
+        } else {
+            sink.write(token.value);
+        }
+    }
+
+    static constexpr char closingBracket(char openingBracket) {
+        return openingBracket == leftBrace ? rightBrace : rightBracket;
+    }
+public:
+    template<typename TTokenReader, typename TSink>
+    static void format(TTokenReader& reader, TSink& sink, FormatStyle style = FormatStyle::Minified, size_t indentWidth = 2) {
+        const bool indented = (style == FormatStyle::Indented);
+        // Opening brackets of the containers being written
+        std::vector<char> openBrackets;
+        bool wroteTopLevelValue = false;
+        TokenView token;
+        bool hasToken = reader.next(token);
+        while (hasToken) {
+            if (openBrackets.empty() && wroteTopLevelValue) {
+                sink.write("\n");
+            }
+            const char specifier = (token.type == TokenType::JsonFormatSpecifier) ? token.value[0] : '\0';
+            if (specifier == leftBrace || specifier == leftBracket) {
+                sink.write(token.value);
+                if (!reader.next(token)) {
+                    throw std::invalid_argument("Unexpected end of input");
+                }
+                if (token.type == TokenType::JsonFormatSpecifier && token.value[0] == closingBracket(specifier)) {
+                    sink.write(token.value);
+                } else {
+                    openBrackets.push_back(specifier);
+                    if (indented) {
+                        writeNewline(sink, openBrackets.size(), indentWidth);
+                    }
+                    // The token following the opening bracket has not been written yet
+                    continue;
+                }
+            } else if (specifier == rightBrace || specifier == rightBracket) {
+                if (openBrackets.empty() || closingBracket(openBrackets.back()) != specifier) {
+                    throw std::invalid_argument("Mismatched closing bracket");
+                }
+                openBrackets.pop_back();
+                if (indented) {
+                    writeNewline(sink, openBrackets.size(), indentWidth);
+                }
+                sink.write(token.value);
+            } else if (specifier == comma) {
+                sink.write(token.value);
+                if (indented) {
+                    writeNewline(sink, openBrackets.size(), indentWidth);
+                }
+            } else if (specifier == colon) {
+                sink.write(indented ? ": " : ":");
+            } else {
+                writeToken(sink, token);
+            }
+            wroteTopLevelValue = openBrackets.empty();
+            hasToken = reader.next(token);
+        }
+        if (!openBrackets.empty()) {
+            throw std::invalid_argument("Unexpected end of input");
+        }
+    }
+
+    static std::string minify(std::string_view input) {
+        std::string output;
+        output.reserve(input.size());
+        ViewTokenReader reader(input);
+        StringSink sink(output);
+        format(reader, sink, FormatStyle::Minified);
+        return output;
+    }
+
+    static std::string prettyPrint(std::string_view input, size_t indentWidth = 2) {
+        std::string output;
+        ViewTokenReader reader(input);
+        StringSink sink(output);
+        format(reader, sink, FormatStyle::Indented, indentWidth);
+        return output;
+    }
+};
+
+}
+
+#endif /* formatter_h */
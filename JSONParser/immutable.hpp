@@ -0,0 +1,225 @@
+//
+//  immutable.hpp
+//  JSONParser
+//
+
+#ifndef immutable_h
+#define immutable_h
+
+#include "JsonValue.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace JSONParser {
+
+class ImmutableValue;
+using ImmutableObject = GenericObject<ImmutableValue>;
+using ImmutableArray = GenericArray<ImmutableValue>;
+
+// Object keys and array indices leading from a value to one of its descendants
+using JSONPath = std::vector<std::variant<std::string, size_t>>;
+
+// Reference counted, immutable counterpart of JSONValue. Copies are O(1) and share the whole tree.
+// Modifiers return a new version that copies only the nodes on the path to the modified member;
+// everything else is shared with the original. Nodes are never modified once built, so any number of
+// threads may read, copy and derive new versions from the same value concurrently.
+class ImmutableValue {
+    using Object = ImmutableObject;
+    using Array = ImmutableArray;
+    std::variant<std::monostate, std::shared_ptr<const std::string>, double, uint64_t, bool,
+                 std::shared_ptr<const Object>, std::shared_ptr<const Array>> value_;
+
+    ImmutableValue setIn(const JSONPath& path, size_t depth, const ImmutableValue& value) const {
+        if (depth == path.size()) {
+            return value;
+        }
+        const auto& step = path[depth];
+        if (const auto key = std::get_if<std::string>(&step)) {
+            return setMember(*key, getObject().getValue(*key).setIn(path, depth + 1, value));
+        }
+        const auto pos = std::get<size_t>(step);
+        return setElement(pos, at(pos).setIn(path, depth + 1, value));
+    }
+
+    const ImmutableValue& at(size_t pos) const {
+        const auto& array = getArray();
+        if (pos >= array.size()) {
+            throw std::out_of_range("Array index out of range");
+        }
+        return array[pos];
+    }
+public:
+    ImmutableValue() = default;
+    ImmutableValue(const std::string& string): value_(std::make_shared<const std::string>(string)) {}
+    ImmutableValue(const char* cStr): value_(std::make_shared<const std::string>(cStr)) {}
+    ImmutableValue(const double num): value_(num) {}
+    ImmutableValue(const uint64_t num): value_(num) {}
+    ImmutableValue(const bool boolean): value_(boolean) {}
+    ImmutableValue(Object object): value_(std::make_shared<const Object>(std::move(object))) {}
+    ImmutableValue(Array array): value_(std::make_shared<const Array>(std::move(array))) {}
+
+    // Deep copies a mutable tree into an immutable one
+    explicit ImmutableValue(const JSONValue& value) {
+        if (value.isString()) {
+            value_ = std::make_shared<const std::string>(value.getString());
+        } else if (value.isDouble()) {
+            value_ = value.getDouble();
+        } else if (value.isInteger()) {
+            value_ = value.getInteger();
+        } else if (value.isBool()) {
+            value_ = value.getBool();
+        } else if (value.isObject()) {
+            Object object;
+            for (const auto& [key, member] : value.getObject()) {
+                object.setMember(key, ImmutableValue(member));
+            }
+            value_ = std::make_shared<const Object>(std::move(object));
+        } else if (value.isArray()) {
+            Array array;
+            for (const auto& member : value.getArray()) {
+                array.addMember(ImmutableValue(member));
+            }
+            value_ = std::make_shared<const Array>(std::move(array));
+        }
+    }
+
+    bool isNull() const {  return value_.index() == 0; }
+    bool isString() const {  return value_.index() == 1; }
+    bool isDouble() const {  return value_.index() == 2; }
+    bool isInteger() const {  return value_.index() == 3; }
+    bool isBool() const {  return value_.index() == 4; }
+    bool isObject() const {  return value_.index() == 5; }
+    bool isArray() const {  return value_.index() == 6; }
+
+    const std::string& getString() const {  return *std::get<std::shared_ptr<const std::string>>(value_); }
+    double getDouble() const {  return std::get<double>(value_); }
+    uint64_t getInteger() const {  return std::get<uint64_t>(value_); }
+    bool getBool() const {  return std::get<bool>(value_); }
+    const Object& getObject() const {  return *std::get<std::shared_ptr<const Object>>(value_); }
+    const Array& getArray() const {  return *std::get<std::shared_ptr<const Array>>(value_); }
+
+    std::optional<std::string> getOptString() const {
+        if (isString()) return getString();
+        return std::nullopt;
+    }
+
+    std::optional<double> getOptDouble() const {
+        if (isDouble()) return getDouble();
+        return std::nullopt;
+    }
+
+    std::optional<uint64_t> getOptInteger() const {
+        if (isInteger()) return getInteger();
+        return std::nullopt;
+    }
+
+    std::optional<bool> getOptBool() const {
+        if (isBool()) return getBool();
+        return std::nullopt;
+    }
+
+    // True if both values refer to the same string, object or array node
+    bool sharesNodeWith(const ImmutableValue& other) const {
+        if (value_.index() != other.value_.index()) {
+            return false;
+        }
+        if (isString()) {
+            return std::get<1>(value_) == std::get<1>(other.value_);
+        }
+        if (isObject()) {
+            return std::get<5>(value_) == std::get<5>(other.value_);
+        }
+        if (isArray()) {
+            return std::get<6>(value_) == std::get<6>(other.value_);
+        }
+        return false;
+    }
+
+    ImmutableValue getIn(const JSONPath& path) const {
+        ImmutableValue value = *this;
+        for (const auto& step : path) {
+            if (const auto key = std::get_if<std::string>(&step)) {
+                value = value.getObject().getValue(*key);
+            } else {
+                value = value.at(std::get<size_t>(step));
+            }
+        }
+        return value;
+    }
+
+    // The modifiers below leave this value untouched and return the modified version
+
+    ImmutableValue setMember(const std::string& key, const ImmutableValue& value) const {
+        Object object = getObject();
+        object.setMember(key, value);
+        return ImmutableValue(std::move(object));
+    }
+
+    ImmutableValue removeMember(const std::string& key) const {
+        Object object = getObject();
+        object.removeMember(key);
+        return ImmutableValue(std::move(object));
+    }
+
+    ImmutableValue addMember(const ImmutableValue& value) const {
+        Array array = getArray();
+        array.addMember(value);
+        return ImmutableValue(std::move(array));
+    }
+
+    ImmutableValue setElement(size_t pos, const ImmutableValue& value) const {
+        at(pos);
+        Array array = getArray();
+        array[pos] = value;
+        return ImmutableValue(std::move(array));
+    }
+
+    // Replaces the descendant at path, copying only the containers along it
+    ImmutableValue setIn(const JSONPath& path, const ImmutableValue& value) const {
+        return setIn(path, 0, value);
+    }
+
+    // Deep copies into a mutable tree
+    JSONValue toJSONValue() const {
+        if (isString()) {
+            return JSONValue(getString());
+        } else if (isDouble()) {
+            return JSONValue(getDouble());
+        } else if (isInteger()) {
+            return JSONValue(getInteger());
+        } else if (isBool()) {
+            return JSONValue(getBool());
+        } else if (isObject()) {
+            JSONObject object;
+            for (const auto& [key, member] : getObject()) {
+                object.setMember(key, member.toJSONValue());
+            }
+            return JSONValue(object);
+        } else if (isArray()) {
+            JSONArray array;
+            for (const auto& member : getArray()) {
+                array.addMember(member.toJSONValue());
+            }
+            return JSONValue(array);
+        }
+        return JSONValue();
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const ImmutableValue& value) {
+        if (value.isObject()) {
+            os << value.getObject();
+        } else if (value.isArray()) {
+            os << value.getArray();
+        } else {
+            os << value.toJSONValue();
+        }
+        return os;
+    }
+};
+
+}
+
+#endif /* immutable_h */
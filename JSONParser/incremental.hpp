@@ -0,0 +1,243 @@
+//
+//  incremental.hpp
+//  JSONParser
+//
+
+#ifndef incremental_h
+#define incremental_h
+
+#include "parser.hpp"
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace JSONParser {
+
+// Replace removedLength bytes at offset of the source with insertedText
+struct TextEdit {
+    size_t offset;
+    size_t removedLength;
+    std::string insertedText;
+};
+
+// Keeps a document in sync with its source under a sequence of edits. Alongside the document it keeps
+// an index of where every value lies in the source, so an edit only lexes and parses the smallest value
+// enclosing it; the index is then shifted past the edit instead of being rebuilt.
+class IncrementalParser {
+    static constexpr size_t noSpan = static_cast<size_t>(-1);
+
+    // Bytes [begin, end) of the source taken up by a value, quotes and brackets included. Spans are
+    // kept in document order, so the values inside a container directly follow it.
+    struct Span {
+        size_t begin;
+        size_t end;
+        size_t parent;
+        // Key of an object member, escape sequences kept as is like in the document
+        size_t keyBegin;
+        size_t keySize;
+        // Position of an array element
+        size_t index;
+    };
+
+    // A container that is open while indexing
+    struct Frame {
+        size_t span;
+        // Key of the member being indexed, or noSpan while the key is still expected
+        size_t keyBegin;
+        size_t keySize;
+        size_t index;
+    };
+
+    std::string source_;
+    JSONObject document_;
+    std::vector<Span> spans_;
+    size_t tokensLexed_ = 0;
+
+    IncrementalParser(std::string source, JSONObject document): source_(std::move(source)), document_(std::move(document)) {
+        spans_ = indexValue(0, source_.size(), Span{0, 0, noSpan, 0, 0, 0}, 0);
+    }
+
+    bool isObject(size_t span) const { return source_[spans_[span].begin] == leftBrace; }
+
+    // Indexes the value in source bytes [begin, end), which has been parsed successfully. Its position
+    // in the document is taken from placement, and its span will be stored at firstSpan in spans_.
+    std::vector<Span> indexValue(size_t begin, size_t end, const Span& placement, size_t firstSpan) {
+        std::vector<Span> spans;
+        std::vector<Frame> stack;
+        const std::string_view text(source_.data(), end);
+        size_t position = begin;
+        while (true) {
+            size_t consumed;
+            const auto token = Lexer::lexToken(text.substr(position), consumed);
+            if (token.type == TokenType::None) {
+                return spans;
+            }
+            ++tokensLexed_;
+            position += consumed;
+            const auto tokenBegin = position - token.value.size() - (token.type == TokenType::String ? 2 : 0);
+            if (!stack.empty() && token.type == TokenType::String && stack.back().keyBegin == noSpan) {
+                stack.back().keyBegin = tokenBegin + 1;
+                stack.back().keySize = token.value.size();
+                continue;
+            }
+            const char specifier = (token.type == TokenType::JsonFormatSpecifier) ? token.value[0] : '\0';
+            if (specifier == rightBrace || specifier == rightBracket) {
+                spans[stack.back().span - firstSpan].end = position;
+                stack.pop_back();
+                continue;
+            }
+            if (specifier == comma) {
+                if (source_[spans[stack.back().span - firstSpan].begin] == leftBrace) {
+                    stack.back().keyBegin = noSpan;
+                } else {
+                    ++stack.back().index;
+                }
+                continue;
+            }
+            if (specifier == colon) {
+                continue;
+            }
+            auto span = placement;
+            if (!stack.empty()) {
+                const auto& frame = stack.back();
+                span = Span{0, 0, frame.span, frame.keyBegin, frame.keySize, frame.index};
+            }
+            span.begin = tokenBegin;
+            span.end = position;
+            spans.push_back(span);
+            if (specifier == leftBrace || specifier == leftBracket) {
+                stack.push_back(Frame{firstSpan + spans.size() - 1, specifier == leftBrace ? noSpan : 0, 0, 0});
+            }
+        }
+    }
+
+    // Innermost value whose span contains the bytes [begin, end), or noSpan
+    size_t enclosingSpan(size_t begin, size_t end) const {
+        const auto it = std::upper_bound(spans_.begin(), spans_.end(), begin, [](size_t offset, const Span& span) {
+            return offset < span.begin;
+        });
+        if (it == spans_.begin()) {
+            return noSpan;
+        }
+        auto span = static_cast<size_t>(std::prev(it) - spans_.begin());
+        while (span != noSpan && !(spans_[span].begin <= begin && end <= spans_[span].end)) {
+            span = spans_[span].parent;
+        }
+        return span;
+    }
+
+    JSONValue& resolve(size_t span) {
+        std::vector<size_t> path;
+        for (; span != 0; span = spans_[span].parent) {
+            path.push_back(span);
+        }
+        JSONValue* value = nullptr;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            const auto& step = spans_[*it];
+            if (step.parent == 0 || isObject(step.parent)) {
+                const auto key = source_.substr(step.keyBegin, step.keySize);
+                value = (step.parent == 0) ? &document_.getValue(key) : &value->getObject().getValue(key);
+            } else {
+                auto& array = value->getArray();
+                if (step.index >= array.size()) {
+                    throw std::invalid_argument("Document does not match its source");
+                }
+                value = &array[step.index];
+            }
+        }
+        return *value;
+    }
+
+    // Replaces the value at span with the edited text of its span, if that still parses as a value
+    bool replaceValue(size_t span, const TextEdit& edit) {
+        const auto oldSpan = spans_[span];
+        const auto editEnd = edit.offset + edit.removedLength;
+        std::string valueSource;
+        valueSource.reserve(oldSpan.end - oldSpan.begin - edit.removedLength + edit.insertedText.size());
+        valueSource.append(source_, oldSpan.begin, edit.offset - oldSpan.begin);
+        valueSource.append(edit.insertedText);
+        valueSource.append(source_, editEnd, oldSpan.end - editEnd);
+        // The edit may have changed how the rest of the document lexes, e.g. by adding a quote
+        auto value = Parser::tryParseValue(valueSource);
+        if (!value) {
+            return false;
+        }
+        resolve(span) = std::move(*value);
+        source_.replace(edit.offset, edit.removedLength, edit.insertedText);
+
+        // Reindex the new value and shift the spans after it
+        auto subtreeEnd = span + 1;
+        while (subtreeEnd < spans_.size() && spans_[subtreeEnd].begin < oldSpan.end) {
+            ++subtreeEnd;
+        }
+        auto newSpans = indexValue(oldSpan.begin, oldSpan.begin + valueSource.size(), oldSpan, span);
+        // Both wrap around when the value shrank, which shifts down
+        const auto shift = valueSource.size() - (oldSpan.end - oldSpan.begin);
+        const auto spanShift = newSpans.size() - (subtreeEnd - span);
+        for (auto it = spans_.begin() + static_cast<std::ptrdiff_t>(subtreeEnd); it != spans_.end(); ++it) {
+            it->begin += shift;
+            it->end += shift;
+            it->keyBegin += shift;
+            if (it->parent != noSpan && it->parent >= subtreeEnd) {
+                it->parent += spanShift;
+            }
+        }
+        for (auto ancestor = oldSpan.parent; ancestor != noSpan; ancestor = spans_[ancestor].parent) {
+            spans_[ancestor].end += shift;
+        }
+        spans_.erase(spans_.begin() + static_cast<std::ptrdiff_t>(span), spans_.begin() + static_cast<std::ptrdiff_t>(subtreeEnd));
+        spans_.insert(spans_.begin() + static_cast<std::ptrdiff_t>(span), newSpans.begin(), newSpans.end());
+        return true;
+    }
+public:
+    // Throws like Parser::parse if source does not parse
+    explicit IncrementalParser(std::string source): IncrementalParser(source, Parser::parse(source)) {}
+
+    const std::string& source() const { return source_; }
+    const JSONObject& document() const { return document_; }
+
+    // Tokens lexed to index the source, so far. Parsing the edited values lexes them once more.
+    size_t tokensLexed() const { return tokensLexed_; }
+
+    // Applies edit to the source and brings the document up to date. Only the innermost value enclosing
+    // the edit, or failing that the container holding it, is parsed again and spliced into the document;
+    // edits to the root object itself fall back to a full parse. Returns false if a full parse was
+    // needed. Object keys are assumed to be unique.
+    // Throws if the edited source does not parse, in which case the document and source are left unchanged.
+    bool apply(const TextEdit& edit) {
+        if (edit.offset > source_.size() || edit.removedLength > source_.size() - edit.offset) {
+            throw std::out_of_range("Edit is outside of the source");
+        }
+        auto span = enclosingSpan(edit.offset, edit.offset + edit.removedLength);
+        for (int attempt = 0; attempt < 2 && span != noSpan && span != 0; ++attempt, span = spans_[span].parent) {
+            if (replaceValue(span, edit)) {
+                return true;
+            }
+        }
+        std::string editedSource = source_;
+        editedSource.replace(edit.offset, edit.removedLength, edit.insertedText);
+        *this = IncrementalParser(std::move(editedSource));
+        return false;
+    }
+
+    // Applies a single edit to source and document, previously parsed from source, like apply. Indexes
+    // the whole source first; keep an IncrementalParser for a sequence of edits.
+    static bool reparse(JSONObject& document, std::string& source, const TextEdit& edit) {
+        IncrementalParser parser(std::move(source), std::move(document));
+        bool incremental = false;
+        try {
+            incremental = parser.apply(edit);
+        } catch (...) {
+            source = std::move(parser.source_);
+            document = std::move(parser.document_);
+            throw;
+        }
+        source = std::move(parser.source_);
+        document = std::move(parser.document_);
+        return incremental;
+    }
+};
+
+}
+
+#endif /* incremental_h */
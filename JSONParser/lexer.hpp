@@ -14,6 +14,7 @@
 #include <cctype>
 #include <algorithm>
 #include <cstring>
+#include "result.hpp"
 
 namespace JSONParser {
 
@@ -23,6 +24,7 @@ constexpr auto falseString = "false";
 constexpr auto nullString = "null";
 constexpr char negativeSign = '-';
 constexpr char dot = '.';
+constexpr char backslash = '\\';
 constexpr char comma = ',';
 constexpr char colon = ':';
 constexpr char leftBrace = '{';
@@ -32,20 +34,38 @@ constexpr char rightBracket = ']';
 constexpr auto jSONFormatSpecifiers = {comma, colon, leftBrace, rightBrace, leftBracket, rightBracket};
 
 struct StringLexer {
-    static constexpr std::string_view lex(const std::string_view inputString) {
+    // closed is set to false if the string has no closing quote
+    static constexpr std::string_view tryLex(const std::string_view inputString, bool& closed) noexcept {
+        closed = true;
         if (inputString.length() == 0 || inputString[0] != doubleQuote) {
             return std::string_view();
         }
         const auto stringBegin = inputString.begin() + 1;
-        const auto closingIt = std::find(stringBegin, inputString.end(), doubleQuote);
+        auto closingIt = stringBegin;
+        while (closingIt != inputString.end() && *closingIt != doubleQuote) {
+            // Escaped characters, including quotes, are kept as is
+            if (*closingIt == backslash && std::next(closingIt) != inputString.end()) {
+                ++closingIt;
+            }
+            ++closingIt;
+        }
         if (closingIt != inputString.end()) {
             return std::string_view(
                                     (stringBegin != closingIt) ? &*stringBegin : nullptr,
                                     (closingIt - stringBegin)
                                 );
-        } else {
-            throw std::out_of_range("Cannot find closing quote");
         }
+        closed = false;
+        return std::string_view();
+    }
+    
+    static constexpr std::string_view lex(const std::string_view inputString) {
+        bool closed = true;
+        const auto lexed = tryLex(inputString, closed);
+        if (!closed) {
+            throwError(ErrorCode::UnterminatedString);
+        }
+        return lexed;
     }
 };
 
@@ -77,6 +97,18 @@ struct NumberLexer {
         if (previousChar == dot) {
             --it;
         }
+        if (it != inputString.end() && (*it == 'e' || *it == 'E') && std::isdigit(previousChar)) {
+            auto exponentIt = std::next(it);
+            if (exponentIt != inputString.end() && (*exponentIt == '+' || *exponentIt == negativeSign)) {
+                ++exponentIt;
+            }
+            if (exponentIt != inputString.end() && std::isdigit(*exponentIt)) {
+                while (exponentIt != inputString.end() && std::isdigit(*exponentIt)) {
+                    ++exponentIt;
+                }
+                it = exponentIt;
+            }
+        }
         const auto length = (it - inputString.begin());
         if (length > 1 || inputString[0] != negativeSign) {
             return std::string_view(inputString.data(), length);
@@ -132,73 +164,244 @@ enum class TokenType {
 struct Token {
     std::string value;
     TokenType type;
-    Token(const std::string& value, TokenType type): value(value), type(type) {}
+    // Byte offset in the lexed input, quotes included for strings
+    size_t offset;
+    Token(const std::string& value, TokenType type, size_t offset = 0): value(value), type(type), offset(offset) {}
+};
+#pragma clang diagnostic pop
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Token referring to the lexed input instead of owning a copy of it
+struct TokenView {
+    std::string_view value;
+    TokenType type;
 };
 #pragma clang diagnostic pop
 
+// Whether token, a Token or a TokenView, is the format specifier given
+template<typename TToken>
+constexpr bool isSpecifier(const TToken& token, char specifier) noexcept {
+    return token.type == TokenType::JsonFormatSpecifier && token.value[0] == specifier;
+}
+
 class Lexer {
-    static constexpr std::pair<std::string_view, TokenType> tryLex(const std::string_view inputString) {
-        auto lexedString = StringLexer::lex(inputString);
-        if (lexedString.size() > 0) {
-            return std::make_pair(lexedString, TokenType::String);
+    static constexpr TokenView lexAt(const std::string_view inputString, ErrorCode& error) noexcept {
+        if (inputString.size() > 0 && inputString[0] == doubleQuote) {
+            bool closed = true;
+            const auto lexedString = StringLexer::tryLex(inputString, closed);
+            if (!closed) {
+                error = ErrorCode::UnterminatedString;
+                return TokenView{std::string_view(), TokenType::None};
+            }
+            return TokenView{lexedString, TokenType::String};
         }
         
         auto lexedNumber = NumberLexer::lex(inputString);
         if (lexedNumber.size() > 0) {
-            bool isDouble = (lexedNumber.find('.') != std::string_view::npos);
-            return std::make_pair(lexedNumber, isDouble ? TokenType::Double : TokenType::Int);
+            bool isDouble = (lexedNumber.find_first_of(".eE") != std::string_view::npos);
+            return TokenView{lexedNumber, isDouble ? TokenType::Double : TokenType::Int};
         }
         
         auto lexedBool = BoolLexer::lex(inputString);
         if (lexedBool.size() > 0) {
-            return std::make_pair(lexedBool, TokenType::Bool);
+            return TokenView{lexedBool, TokenType::Bool};
         }
         
         auto lexedNull = NullLexer::lex(inputString);
         if (lexedNull.size() > 0) {
-            return std::make_pair(lexedNull, TokenType::Null);
+            return TokenView{lexedNull, TokenType::Null};
         }
         
         auto lexedFormatSpecifier = JsonFormatLexer::lex(inputString);
         if (lexedFormatSpecifier.size() > 0) {
-            return std::make_pair(lexedFormatSpecifier, TokenType::JsonFormatSpecifier);
+            return TokenView{lexedFormatSpecifier, TokenType::JsonFormatSpecifier};
         }
         
-        return std::make_pair(std::string_view(), TokenType::None);
+        error = ErrorCode::InvalidToken;
+        return TokenView{std::string_view(), TokenType::None};
     }
 public:
-    static std::vector<Token> lex(const std::string& inputString) {
+    // Non throwing lexToken. On failure error is set, a TokenType::None token returned and consumed set
+    // to the number of whitespace characters before the offending one.
+    static TokenView lexToken(const std::string_view inputString, size_t& consumed, ErrorCode& error) noexcept {
+        // Remove whitespaces from begining
+        auto it = inputString.begin();
+        while (it != inputString.end() && std::isspace(*it)) {
+            ++it;
+        }
+        const auto whitespaceSize = static_cast<size_t>(it - inputString.begin());
+        consumed = whitespaceSize;
+        if (whitespaceSize == inputString.size()) {
+            return TokenView{std::string_view(), TokenType::None};
+        }
+        
+        const auto token = lexAt(inputString.substr(whitespaceSize), error);
+        if (token.type != TokenType::None) {
+            consumed += token.value.size() + (token.type == TokenType::String ? 2 : 0);
+        }
+        return token;
+    }
+    
+    // Lexes the token following any whitespace at the start of inputString, without copying it.
+    // consumed is set to the number of characters taken up by the whitespace and the token, including
+    // the quotes of a string. Returns a TokenType::None token if only whitespace is left.
+    static TokenView lexToken(const std::string_view inputString, size_t& consumed) {
+        ErrorCode error = ErrorCode::None;
+        const auto token = lexToken(inputString, consumed, error);
+        if (error != ErrorCode::None) {
+            throwError(error);
+        }
+        return token;
+    }
+    
+    // Lexes the token at the start of input like lexToken and removes it, along with the whitespace
+    // before it, from input. Returns a TokenType::None token if only whitespace is left.
+    static TokenView takeToken(std::string_view& input) {
+        size_t consumed;
+        const auto token = lexToken(input, consumed);
+        input.remove_prefix(consumed);
+        return token;
+    }
+    
+    // takeToken for when a value or specifier must follow, throws if only whitespace is left
+    static TokenView nextToken(std::string_view& input) {
+        const auto token = takeToken(input);
+        if (token.type == TokenType::None) {
+            throwError(ErrorCode::UnexpectedEnd);
+        }
+        return token;
+    }
+    
+    static Expected<std::vector<Token>> tryLex(const std::string& inputString) {
         std::string_view inputStringView = inputString;
         std::vector<Token> lexOutput;
+        size_t offset = 0;
         while (inputStringView.size() > 0) {
-            // Remove whitespaces from begining
-            auto it = inputStringView.begin();
-            while (it != inputStringView.end() && std::isspace(*it)) {
-                ++it;
+            size_t consumed;
+            ErrorCode error = ErrorCode::None;
+            const auto token = lexToken(inputStringView, consumed, error);
+            if (error != ErrorCode::None) {
+                return ParseError::at(inputString, offset + consumed, error);
             }
-            inputStringView.remove_prefix(it - inputStringView.begin());
-            
-            if (inputStringView.size() == 0) {
+            if (token.type == TokenType::None) {
                 break;
             }
-            
-            auto [lexedString, tokenType] = tryLex(inputStringView);
-            
-            if (lexedString.size() == 0) {
-                throw std::invalid_argument("Can't lex the input string");
-            }
+            const auto tokenSize = token.value.size() + (token.type == TokenType::String ? 2 : 0);
+            lexOutput.emplace_back(std::string(token.value), token.type, offset + consumed - tokenSize);
+            inputStringView.remove_prefix(consumed);
+            offset += consumed;
+        }
+        return lexOutput;
+    }
+    
+    static std::vector<Token> lex(const std::string& inputString) {
+        auto result = tryLex(inputString);
+        if (!result) {
+            throwError(result.error().code);
+        }
+        return std::move(*result);
+    }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Accumulates input arriving in chunks and lexes the complete tokens in it. Tokens cut off by the end of
+// the buffered input are only lexed once more input, or the end of it, has been committed.
+class TokenBuffer {
+    std::vector<char> buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool endOfInput_ = false;
+
+    // Whether token, followed by rest in the buffer, could still grow with more input. Numbers and
+    // literals may run up to the end of the buffer, and NumberLexer stops before a trailing dot,
+    // exponent or exponent sign until the digits after it arrive.
+    static bool mayContinue(const TokenView& token, std::string_view rest) {
+        switch (token.type) {
+            case TokenType::Int:
+            case TokenType::Double:
+                if (rest.empty()) {
+                    return true;
+                }
+                if (rest == std::string_view(&dot, 1)) {
+                    return token.value.find_first_of(".eE") == std::string_view::npos;
+                }
+                if ((rest[0] == 'e' || rest[0] == 'E') && (rest.size() == 1 || (rest.size() == 2 && (rest[1] == '+' || rest[1] == negativeSign)))) {
+                    return token.value.find_first_of("eE") == std::string_view::npos;
+                }
+                return false;
+            case TokenType::Bool:
+            case TokenType::Null:
+                return rest.empty();
+            case TokenType::String:
+            case TokenType::JsonFormatSpecifier:
+                return false;
+            case TokenType::None:
+                // Only whitespace is buffered
+                return true;
+        }
+        return false;
+    }
 
-            lexOutput.emplace_back(std::string(lexedString), tokenType);
-            if (tokenType != TokenType::String) {
-                inputStringView.remove_prefix(lexedString.size());
-            } else {
-                auto prefixSize = std::min(lexedString.size() + 2, inputStringView.size());
-                inputStringView.remove_prefix(prefixSize);
+    // Whether rest, which failed to lex and runs to the end of the buffer, could still become a token
+    // with more input: an unterminated string, a lone minus sign or the start of a literal
+    static bool mayComplete(ErrorCode error, std::string_view rest) {
+        if (error == ErrorCode::UnterminatedString || rest == std::string_view(&negativeSign, 1)) {
+            return true;
+        }
+        for (const std::string_view literal : {trueString, falseString, nullString}) {
+            if (rest.size() < literal.size() && literal.compare(0, rest.size(), rest) == 0) {
+                return true;
             }
         }
-        return lexOutput;
+        return false;
+    }
+public:
+    explicit TokenBuffer(size_t chunkSize = 64 * 1024): buffer_(std::max<size_t>(chunkSize, 1)) {}
+    
+    // Returns false if more input has to be committed first. Once the end of the input is committed,
+    // returns a TokenType::None token when no tokens are left. A token stays valid until the next call.
+    // Throws as soon as the buffered bytes cannot start a token, without waiting for the rest of the input.
+    bool tryNext(TokenView& token) {
+        const std::string_view available(buffer_.data() + begin_, end_ - begin_);
+        size_t consumed = 0;
+        ErrorCode error = ErrorCode::None;
+        token = Lexer::lexToken(available, consumed, error);
+        if (error != ErrorCode::None) {
+            // A token cut off by the end of the buffer may not lex yet, anything else fails right away
+            if (endOfInput_ || !mayComplete(error, available.substr(consumed))) {
+                throwError(error);
+            }
+            return false;
+        }
+        if (!endOfInput_ && mayContinue(token, available.substr(consumed))) {
+            return false;
+        }
+        begin_ += consumed;
+        return true;
+    }
+    
+    // Makes room for the next chunk and returns where to write it and how many bytes fit
+    std::pair<char*, size_t> prepareWrite() {
+        if (begin_ > 0) {
+            std::copy(buffer_.begin() + static_cast<std::ptrdiff_t>(begin_), buffer_.begin() + static_cast<std::ptrdiff_t>(end_), buffer_.begin());
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (end_ == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+        return std::make_pair(buffer_.data() + end_, buffer_.size() - end_);
+    }
+    
+    // Commits bytes written after prepareWrite, zero marks the end of the input
+    void commit(size_t size) {
+        end_ += size;
+        endOfInput_ = (size == 0);
     }
 };
+#pragma clang diagnostic pop
 
 }
 
@@ -0,0 +1,289 @@
+//
+//  parallel.hpp
+//  JSONParser
+//
+
+#ifndef parallel_h
+#define parallel_h
+
+#include "JsonValue.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace JSONParser {
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Thread pool with one task deque per worker. Workers take their own newest task first and steal the
+// oldest task of another worker when they run dry, so large subtrees split off early spread across cores.
+class TaskPool {
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> queuedTasks_{0};
+    std::atomic<size_t> nextWorker_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable wakeUp_;
+
+    static inline thread_local TaskPool* currentPool_ = nullptr;
+    static inline thread_local size_t currentWorker_ = 0;
+
+    size_t homeWorker() {
+        if (currentPool_ == this) {
+            return currentWorker_;
+        }
+        return nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    }
+
+    bool tryRunOne(size_t home) {
+        std::function<void()> task;
+        for (size_t i = 0; i < workers_.size() && !task; ++i) {
+            auto& worker = *workers_[(home + i) % workers_.size()];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+            } else {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+            }
+        }
+        if (!task) {
+            return false;
+        }
+        queuedTasks_.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        currentPool_ = this;
+        currentWorker_ = index;
+        while (!stopping_.load(std::memory_order_acquire)) {
+            if (!tryRunOne(index)) {
+                std::unique_lock<std::mutex> lock(sleepMutex_);
+                wakeUp_.wait(lock, [this]() {
+                    return stopping_.load(std::memory_order_acquire) || queuedTasks_.load(std::memory_order_relaxed) > 0;
+                });
+            }
+        }
+    }
+public:
+    explicit TaskPool(size_t numThreads = std::max(1u, std::thread::hardware_concurrency())) {
+        numThreads = std::max<size_t>(numThreads, 1);
+        for (size_t i = 0; i < numThreads; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads_.emplace_back(&TaskPool::workerLoop, this, i);
+        }
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stopping_.store(true, std::memory_order_release);
+        }
+        wakeUp_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    // Queues task on the calling worker's deque, or on one picked round robin when called from outside the pool
+    void spawn(std::function<void()> task) {
+        auto& worker = *workers_[homeWorker()];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            queuedTasks_.fetch_add(1, std::memory_order_relaxed);
+        }
+        wakeUp_.notify_one();
+    }
+
+    // Runs queued tasks on the calling thread until done returns true
+    template<typename TPredicate>
+    void helpUntil(TPredicate done) {
+        const auto home = (currentPool_ == this) ? currentWorker_ : 0;
+        while (!done()) {
+            if (!tryRunOne(home)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+#pragma clang diagnostic pop
+
+// Set of tasks that are waited for together. The first exception thrown by a task is rethrown by wait.
+class TaskGroup {
+    TaskPool& pool_;
+    std::atomic<size_t> pending_{0};
+    std::mutex errorMutex_;
+    std::exception_ptr error_;
+public:
+    explicit TaskGroup(TaskPool& pool): pool_(pool) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup() {
+        pool_.helpUntil([this]() { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+    template<typename TFunction>
+    void run(TFunction function) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        pool_.spawn([this, function = std::move(function)]() mutable {
+            try {
+                function();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+            pending_.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void wait() {
+        pool_.helpUntil([this]() { return pending_.load(std::memory_order_acquire) == 0; });
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+};
+
+// The functions below only read the tree, see the thread safety note on JSONValue.
+// The tree must not be modified until they return.
+
+namespace Detail {
+
+// Calls function(i) for every i in [begin, end), splitting off the upper halves as stealable tasks.
+// function is referenced by the tasks and must outlive the group's wait.
+template<typename TFunction>
+void forEachIndex(TaskGroup& group, size_t begin, size_t end, size_t grainSize, const TFunction& function) {
+    while (end - begin > grainSize) {
+        const auto mid = begin + (end - begin) / 2;
+        group.run([&group, mid, end, grainSize, &function]() {
+            forEachIndex(group, mid, end, grainSize, function);
+        });
+        end = mid;
+    }
+    for (auto i = begin; i < end; ++i) {
+        function(i);
+    }
+}
+
+template<typename TFunction>
+void visit(TaskGroup& group, const JSONValue& value, const TFunction& visitor) {
+    visitor(value);
+    const auto visitChild = [&group, &visitor](const JSONValue& child) {
+        if (child.isObject() || child.isArray()) {
+            group.run([&group, &child, &visitor]() { visit(group, child, visitor); });
+        } else {
+            visitor(child);
+        }
+    };
+    if (value.isObject()) {
+        for (const auto& member : value.getObject()) {
+            visitChild(member.second);
+        }
+    } else if (value.isArray()) {
+        for (const auto& member : value.getArray()) {
+            visitChild(member);
+        }
+    }
+}
+
+}
+
+// Calls function(element, index) for every element of array, in parallel and in no particular order
+template<typename TFunction>
+void parallelForEach(TaskPool& pool, const JSONArray& array, TFunction function, size_t grainSize = 256) {
+    TaskGroup group(pool);
+    const auto forElement = [&array, &function](size_t i) {
+        function(array[i], i);
+    };
+    Detail::forEachIndex(group, 0, array.size(), std::max<size_t>(grainSize, 1), forElement);
+    group.wait();
+}
+
+// Calls function(key, value) for every member of object, in parallel and in no particular order
+template<typename TFunction>
+void parallelForEach(TaskPool& pool, const JSONObject& object, TFunction function, size_t grainSize = 256) {
+    std::vector<JSONObject::const_iterator> members;
+    members.reserve(object.size());
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        members.push_back(it);
+    }
+    TaskGroup group(pool);
+    const auto forMember = [&members, &function](size_t i) {
+        function(members[i]->first, members[i]->second);
+    };
+    Detail::forEachIndex(group, 0, members.size(), std::max<size_t>(grainSize, 1), forMember);
+    group.wait();
+}
+
+// Folds map(element) over array with reduce, starting from identity. Chunks of grainSize elements are
+// folded in parallel and the partial results combined in order, so reduce only needs to be associative.
+template<typename T, typename TMap, typename TReduce>
+T parallelMapReduce(TaskPool& pool, const JSONArray& array, T identity, TMap map, TReduce reduce, size_t grainSize = 256) {
+    grainSize = std::max<size_t>(grainSize, 1);
+    const auto numChunks = (array.size() + grainSize - 1) / grainSize;
+    std::vector<T> partials(numChunks, identity);
+    TaskGroup group(pool);
+    const auto forChunk = [&](size_t chunk) {
+        const auto end = std::min(array.size(), (chunk + 1) * grainSize);
+        auto partial = identity;
+        for (auto i = chunk * grainSize; i < end; ++i) {
+            partial = reduce(std::move(partial), map(array[i]));
+        }
+        partials[chunk] = std::move(partial);
+    };
+    Detail::forEachIndex(group, 0, numChunks, 1, forChunk);
+    group.wait();
+    auto result = std::move(identity);
+    for (auto& partial : partials) {
+        result = reduce(std::move(result), std::move(partial));
+    }
+    return result;
+}
+
+// Calls visitor(node) for value and every value below it. Every object and array is visited as its own
+// task, so unbalanced subtrees are spread across the pool. visitor must be safe to call concurrently.
+template<typename TVisitor>
+void parallelVisit(TaskPool& pool, const JSONValue& value, TVisitor visitor) {
+    TaskGroup group(pool);
+    Detail::visit(group, value, visitor);
+    group.wait();
+}
+
+}
+
+#endif /* parallel_h */
@@ -10,134 +10,225 @@
 
 #include "lexer.hpp"
 #include "JsonValue.h"
+#include "result.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
 
 namespace JSONParser {
 
 class Parser {
     using TokenVector = std::vector<Token>;
     using TokenConstIterator = TokenVector::const_iterator;
-    using IteratorValuePair = std::pair<TokenConstIterator, JSONValue>;
     
-    static constexpr bool isStringEqualToChar(const std::string& string, char c) noexcept {
-        return string.length() == 1 && string[0] == c;
-    }
+    // The parse functions below return ErrorCode::None and move it past the value on success, or else
+    // the error with it left at the offending token.
     
-    static JSONValue parsePrimitiveToken(const Token& token) {
-        switch (token.type) {
-            case TokenType::Null:
-                return JSONValue();
-            case TokenType::String:
-                return JSONValue(token.value);
-            case TokenType::Double:
-                return JSONValue(std::stod(token.value));
-            case TokenType::Int:
-                return JSONValue(static_cast<uint64_t>(std::stoll(token.value)));
-            case TokenType::Bool:
-                return JSONValue((token.value == "true"));
-            case TokenType::JsonFormatSpecifier:
-            case TokenType::None:
-                throw std::invalid_argument("Trying to parse a non-primitive token into JsonValue");
+    // it points to the token succeeding leftbrace in the lexer output
+    static ErrorCode parseObject(TokenConstIterator& it, TokenConstIterator end, JSONValue& value) {
+        JSONObject object;
+        if (it != end && isSpecifier(*it, rightBrace)) {
+            ++it;
+            value = JSONValue(std::move(object));
+            return ErrorCode::None;
+        }
+        while (true) {
+            if (it == end) {
+                return ErrorCode::MissingClosingBracket;
+            }
+            if (it->type != TokenType::String) {
+                return ErrorCode::ExpectedKey;
+            }
+            const auto& key = it->value;
+            if (++it == end) {
+                return ErrorCode::MissingClosingBracket;
+            }
+            if (!isSpecifier(*it, colon)) {
+                return ErrorCode::ExpectedColon;
+            }
+            JSONValue member;
+            if (const auto error = parseRecursive(++it, end, member); error != ErrorCode::None) {
+                return error;
+            }
+            object.setMember(key, std::move(member));
+            if (it == end) {
+                return ErrorCode::MissingClosingBracket;
+            }
+            if (isSpecifier(*it, rightBrace)) {
+                ++it;
+                value = JSONValue(std::move(object));
+                return ErrorCode::None;
+            }
+            if (!isSpecifier(*it, comma)) {
+                return ErrorCode::MissingClosingBracket;
+            }
+            ++it;
         }
-        
     }
     
-    // begin points to the token succeeding leftbrace in the lexer output
-    static IteratorValuePair parseObject(TokenConstIterator begin, TokenConstIterator end) {
-        auto it = begin;
-        if (isStringEqualToChar((*it).value, rightBrace)) {
-            return std::make_pair(it, JSONObject());
+    // it points to the token succeeding leftbracket in the lexer output
+    static ErrorCode parseArray(TokenConstIterator& it, TokenConstIterator end, JSONValue& value) {
+        JSONArray array;
+        if (it != end && isSpecifier(*it, rightBracket)) {
+            ++it;
+            value = JSONValue(std::move(array));
+            return ErrorCode::None;
         }
-        
-        JSONObject object;
-        
-        while (it != end) {
-            // Need at least 3 tokens now: colon, value and right brace.
-            if ((end - it) < 3) {
-                throw std::invalid_argument("Insufficent tokens in the input");
+        while (true) {
+            JSONValue member;
+            if (const auto error = parseRecursive(it, end, member); error != ErrorCode::None) {
+                return error;
             }
-            
-            const auto firstToken = *it;
-            if (firstToken.type != TokenType::String) {
-                throw std::invalid_argument("Insufficent tokens in the input");
+            array.addMember(std::move(member));
+            if (it == end) {
+                return ErrorCode::MissingClosingBracket;
             }
-            
-            const auto secondToken = *(++it);
-            if (secondToken.type != TokenType::JsonFormatSpecifier || !isStringEqualToChar(secondToken.value, colon)) {
-                throw std::invalid_argument("Insufficent tokens in the input");
+            if (isSpecifier(*it, rightBracket)) {
+                ++it;
+                value = JSONValue(std::move(array));
+                return ErrorCode::None;
             }
-            
-            const auto parseResult = parseRecursive(++it, end);
-            object.setMember(firstToken.value, std::move(parseResult.second));
-            it = parseResult.first;
-            if (it != end) {
-                if (isStringEqualToChar((*it).value, comma)) {
-                    ++it;
-                } else if (isStringEqualToChar((*it).value, rightBrace)) {
-                    return std::make_pair(++it, object);
-                } else {
-                    throw std::invalid_argument("No right bracket in the input");
-                }
-                continue;
+            if (!isSpecifier(*it, comma)) {
+                return ErrorCode::MissingClosingBracket;
             }
-            
+            ++it;
         }
-        throw std::invalid_argument("No right bracket in the input");
     }
     
-    // begin points to the token succeeding leftbracket in the lexer output
-    static IteratorValuePair parseArray(TokenConstIterator begin, TokenConstIterator end) {
-        auto it = begin;
-        if (isStringEqualToChar((*it).value, rightBracket)) {
-            return std::make_pair(it, JSONArray());
+    static ErrorCode parseRecursive(TokenConstIterator& it, TokenConstIterator end, JSONValue& value) {
+        if (it == end) {
+            return ErrorCode::MissingClosingBracket;
         }
-
-        JSONArray array;
-
-        while (it != end) {
-            const auto parseResult = parseRecursive(it, end);
-            array.addMember(parseResult.second);
-            it = parseResult.first;
-            if (it != end) {
-                if (isStringEqualToChar((*it).value, comma)) {
-                    ++it;
-                } else if (isStringEqualToChar((*it).value, rightBracket)) {
-                    return std::make_pair(++it, array);
-                } else {
-                    throw std::invalid_argument("No right bracket in the input");
+        if (isSpecifier(*it, leftBrace)) {
+            return parseObject(++it, end, value);
+        }
+        if (isSpecifier(*it, leftBracket)) {
+            return parseArray(++it, end, value);
+        }
+        const auto error = tryParsePrimitiveToken(TokenView{it->value, it->type}, value);
+        if (error == ErrorCode::None) {
+            ++it;
+        }
+        return error;
+    }
+    
+    static Expected<JSONValue> parseTokens(const std::string& inputString, bool requireObject) {
+        auto tokens = Lexer::tryLex(inputString);
+        if (!tokens) {
+            return tokens.error();
+        }
+        auto it = tokens->cbegin();
+        const auto end = tokens->cend();
+        const auto offsetOf = [&inputString, end](TokenConstIterator tokenIt) {
+            return tokenIt == end ? inputString.size() : tokenIt->offset;
+        };
+        if (it == end || (requireObject && !isSpecifier(*it, leftBrace))) {
+            return ParseError::at(inputString, offsetOf(it), requireObject ? ErrorCode::ExpectedObject : ErrorCode::ExpectedValue);
+        }
+        JSONValue value;
+        if (const auto error = parseRecursive(it, end, value); error != ErrorCode::None) {
+            return ParseError::at(inputString, offsetOf(it), error);
+        }
+        if (it != end) {
+            return ParseError::at(inputString, it->offset, ErrorCode::TrailingTokens);
+        }
+        return value;
+    }
+    
+    static double toDouble(std::string_view text, bool& inRange) {
+        // strtod needs a terminated string; numbers are short enough for the stack
+        char buffer[64];
+        const char* terminated = buffer;
+        std::string longText;
+        if (text.size() < sizeof(buffer)) {
+            std::copy(text.begin(), text.end(), buffer);
+            buffer[text.size()] = '\0';
+        } else {
+            longText = std::string(text);
+            terminated = longText.c_str();
+        }
+        errno = 0;
+        const auto number = std::strtod(terminated, nullptr);
+        inRange = (errno != ERANGE);
+        return number;
+    }
+public:
+    // Non throwing parsePrimitiveToken, value is only set on success
+    static ErrorCode tryParsePrimitiveToken(const TokenView& token, JSONValue& value) {
+        switch (token.type) {
+            case TokenType::Null:
+                value = JSONValue();
+                return ErrorCode::None;
+            case TokenType::String:
+                value = JSONValue(std::string(token.value));
+                return ErrorCode::None;
+            case TokenType::Double: {
+                bool inRange = false;
+                const auto number = toDouble(token.value, inRange);
+                if (!inRange) {
+                    return ErrorCode::NumberOutOfRange;
                 }
-                continue;
+                value = JSONValue(number);
+                return ErrorCode::None;
             }
-            
+            case TokenType::Int: {
+                int64_t number = 0;
+                const auto result = std::from_chars(token.value.data(), token.value.data() + token.value.size(), number);
+                if (result.ec != std::errc()) {
+                    return ErrorCode::NumberOutOfRange;
+                }
+                value = JSONValue(static_cast<uint64_t>(number));
+                return ErrorCode::None;
+            }
+            case TokenType::Bool:
+                value = JSONValue((token.value == trueString));
+                return ErrorCode::None;
+            case TokenType::JsonFormatSpecifier:
+            case TokenType::None:
+                break;
         }
-        throw std::invalid_argument("No right bracket in the input");
+        return ErrorCode::ExpectedValue;
     }
     
-    static IteratorValuePair parseRecursive(TokenConstIterator begin, TokenConstIterator end) {
-        if (begin == end || std::next(begin) == end) {
-            return std::make_pair(begin, JSONValue());
-        }
-        
-        const auto firstToken = *begin;
-        
-        if (firstToken.type != TokenType::JsonFormatSpecifier) {
-            return std::make_pair(parseRecursive(std::next(begin), end).first, parsePrimitiveToken(firstToken)) ;
-        }
-        
-        if (isStringEqualToChar(firstToken.value, leftBrace)) {
-            return parseObject(std::next(begin), end);
-        } else if (isStringEqualToChar(firstToken.value, leftBracket)) {
-            return parseArray(std::next(begin), end);
-        }
-        return std::make_pair(begin, JSONValue());;
+    static JSONValue parsePrimitiveToken(const TokenView& token) {
+        JSONValue value;
+        if (const auto error = tryParsePrimitiveToken(token, value); error != ErrorCode::None) {
+            throwError(error);
+        }
+        return value;
     }
-public:
+    
+    // The try* functions report malformed input through the result instead of throwing, for inputs
+    // that are rejected often and builds without exceptions. Only allocation failures still throw.
+    
+    static Expected<JSONObject> tryParse(const std::string& inputString) {
+        auto result = parseTokens(inputString, true);
+        if (!result) {
+            return result.error();
+        }
+        return std::move(result->getObject());
+    }
+    
+    // Parses any JSON value, not only a top level object
+    static Expected<JSONValue> tryParseValue(const std::string& inputString) {
+        return parseTokens(inputString, false);
+    }
+    
     static JSONObject parse(const std::string& inputString) {
-        const auto lexedTokens = Lexer::lex(inputString);
-        auto endIt = parseRecursive(lexedTokens.begin(), lexedTokens.end());
-        if (endIt.first == lexedTokens.end() && endIt.second.isObject()) {
-            return endIt.second.getObject();
+        auto result = tryParse(inputString);
+        if (!result) {
+            throwError(result.error().code);
+        }
+        return std::move(*result);
+    }
+    
+    static JSONValue parseValue(const std::string& inputString) {
+        auto result = tryParseValue(inputString);
+        if (!result) {
+            throwError(result.error().code);
         }
-        throw std::invalid_argument("Unable to parse the input string");
+        return std::move(*result);
     }
 };
 
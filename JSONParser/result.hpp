@@ -0,0 +1,123 @@
+//
+//  result.hpp
+//  JSONParser
+//
+
+#ifndef result_h
+#define result_h
+
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+// Throws exception, or aborts in builds without exceptions. Every throw in the parsing modules goes
+// through it, so they compile with -fno-exceptions, but malformed input then aborts the process. Only
+// Parser::tryParse, Parser::tryParseValue and Validator::validate report it to the caller instead, so
+// without exceptions check untrusted input with them before handing it to any other parser.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define JSONPARSER_EXCEPTIONS 1
+#define JSONPARSER_THROW(exception) throw exception
+#else
+#define JSONPARSER_EXCEPTIONS 0
+#define JSONPARSER_THROW(exception) std::abort()
+#endif
+
+namespace JSONParser {
+
+enum class ErrorCode {
+    None,
+    InvalidToken,
+    UnterminatedString,
+    NumberOutOfRange,
+    ExpectedValue,
+    ExpectedKey,
+    ExpectedColon,
+    MissingClosingBracket,
+    ExpectedObject,
+    TrailingTokens,
+    UnexpectedEnd
+};
+
+constexpr const char* errorMessage(ErrorCode code) noexcept {
+    switch (code) {
+        case ErrorCode::None: return "No error";
+        case ErrorCode::InvalidToken: return "Can't lex the input string";
+        case ErrorCode::UnterminatedString: return "Cannot find closing quote";
+        case ErrorCode::NumberOutOfRange: return "Number out of range";
+        case ErrorCode::ExpectedValue: return "Expected a value";
+        case ErrorCode::ExpectedKey: return "Expected object key";
+        case ErrorCode::ExpectedColon: return "Expected colon after object key";
+        case ErrorCode::MissingClosingBracket: return "No right bracket in the input";
+        case ErrorCode::ExpectedObject: return "Unable to parse the input string";
+        case ErrorCode::TrailingTokens: return "Unexpected tokens after the value";
+        case ErrorCode::UnexpectedEnd: return "Unexpected end of input";
+    }
+    return "Unknown error";
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+struct ParseError {
+    ErrorCode code;
+    // Byte offset of the offending token, or the input size if the input ended early
+    size_t offset;
+    // Both start at 1, columns count bytes
+    size_t line;
+    size_t column;
+
+    // Only called on failure, so the line is found by scanning the input up to offset
+    static ParseError at(std::string_view input, size_t offset, ErrorCode code) noexcept {
+        size_t line = 1;
+        size_t lineBegin = 0;
+        for (size_t i = 0; i < offset && i < input.size(); ++i) {
+            if (input[i] == '\n') {
+                ++line;
+                lineBegin = i + 1;
+            }
+        }
+        return ParseError{code, offset, line, offset - lineBegin + 1};
+    }
+
+    const char* message() const noexcept { return errorMessage(code); }
+};
+#pragma clang diagnostic pop
+
+// Throws the exception the throwing API reports code with
+[[noreturn]] inline void throwError(ErrorCode code) {
+    if (code == ErrorCode::UnterminatedString || code == ErrorCode::NumberOutOfRange) {
+        JSONPARSER_THROW(std::out_of_range(errorMessage(code)));
+    }
+    JSONPARSER_THROW(std::invalid_argument(errorMessage(code)));
+}
+
+// Either a T or the ParseError explaining why there is none, in the spirit of C++23 std::expected.
+// value() on an error throws std::bad_variant_access, or aborts without exceptions; operator* and
+// operator-> don't check.
+template<typename T>
+class Expected {
+    std::variant<T, ParseError> value_;
+public:
+    Expected(T value): value_(std::move(value)) {}
+    Expected(ParseError error): value_(error) {}
+
+    bool hasValue() const noexcept { return value_.index() == 0; }
+    explicit operator bool() const noexcept { return hasValue(); }
+
+    T& value() & { return std::get<0>(value_); }
+    const T& value() const & { return std::get<0>(value_); }
+    T&& value() && { return std::get<0>(std::move(value_)); }
+
+    T& operator*() noexcept { return *std::get_if<0>(&value_); }
+    const T& operator*() const noexcept { return *std::get_if<0>(&value_); }
+    T* operator->() noexcept { return std::get_if<0>(&value_); }
+    const T* operator->() const noexcept { return std::get_if<0>(&value_); }
+
+    const ParseError& error() const noexcept { return *std::get_if<1>(&value_); }
+};
+
+}
+
+#endif /* result_h */
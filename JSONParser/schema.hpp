@@ -0,0 +1,487 @@
+//
+//  schema.hpp
+//  JSONParser
+//
+
+#ifndef schema_h
+#define schema_h
+
+#include "parser.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace JSONParser {
+
+// Schema violation found while parsing, located by the JSON Pointer of the offending value
+struct SchemaViolation {
+    std::string pointer;
+    std::string message;
+};
+
+// Thrown by SchemaParser on the first violation when aborting is requested
+class SchemaViolationError: public std::invalid_argument {
+    SchemaViolation violation_;
+public:
+    explicit SchemaViolationError(SchemaViolation violation):
+        std::invalid_argument(violation.message + " at " + (violation.pointer.empty() ? "/" : violation.pointer)),
+        violation_(std::move(violation)) {}
+
+    const SchemaViolation& violation() const noexcept { return violation_; }
+};
+
+// JSON Schema subset compiled into a flat table of nodes, one per (sub)schema, which SchemaParser steps
+// through as it parses. Supported keywords: type, required, properties, enum (primitive values only),
+// minimum, maximum, minLength, maxLength, items, minItems and maxItems. Other keywords are ignored.
+// Like the rest of the parser, integer only matches numbers written without a fraction or exponent.
+class CompiledSchema {
+public:
+    enum TypeBits: uint8_t {
+        NullType = 1 << 0,
+        BooleanType = 1 << 1,
+        IntegerType = 1 << 2,
+        DoubleType = 1 << 3,
+        NumberType = IntegerType | DoubleType,
+        StringType = 1 << 4,
+        ObjectType = 1 << 5,
+        ArrayType = 1 << 6,
+        AnyType = 0x7F
+    };
+
+    // Node accepting any value, used for members the schema says nothing about
+    static constexpr size_t anyNode = 0;
+    static constexpr size_t rootNode = 1;
+    static constexpr size_t maxRequired = 64;
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wpadded"
+    struct Property {
+        std::string key;
+        size_t node;
+        // Bit in Node::requiredMask, or -1 if the property is optional
+        int requiredBit;
+    };
+
+    struct Node {
+        uint8_t types = AnyType;
+        std::optional<double> minimum;
+        std::optional<double> maximum;
+        size_t minLength = 0;
+        size_t maxLength = std::numeric_limits<size_t>::max();
+        size_t minItems = 0;
+        size_t maxItems = std::numeric_limits<size_t>::max();
+        size_t items = anyNode;
+        // Sorted by key for allocation free lookups
+        std::vector<Property> properties;
+        uint64_t requiredMask = 0;
+        std::vector<JSONValue> enumValues;
+    };
+    #pragma clang diagnostic pop
+private:
+    std::vector<Node> nodes_;
+
+    static uint8_t typeBit(const std::string& name) {
+        if (name == "null") return NullType;
+        if (name == "boolean") return BooleanType;
+        if (name == "integer") return IntegerType;
+        if (name == "number") return NumberType;
+        if (name == "string") return StringType;
+        if (name == "object") return ObjectType;
+        if (name == "array") return ArrayType;
+        JSONPARSER_THROW(std::invalid_argument("Unknown schema type " + name));
+    }
+
+    static double numberOf(const JSONValue& value) {
+        if (value.isDouble()) {
+            return value.getDouble();
+        }
+        if (value.isInteger()) {
+            // Integers are parsed as signed and stored as unsigned
+            return static_cast<double>(static_cast<int64_t>(value.getInteger()));
+        }
+        JSONPARSER_THROW(std::invalid_argument("Expected a number in schema"));
+    }
+
+    static const JSONObject& objectOf(const JSONValue& value) {
+        if (!value.isObject()) {
+            JSONPARSER_THROW(std::invalid_argument("Expected an object in schema"));
+        }
+        return value.getObject();
+    }
+
+    static const JSONArray& arrayOf(const JSONValue& value) {
+        if (!value.isArray()) {
+            JSONPARSER_THROW(std::invalid_argument("Expected an array in schema"));
+        }
+        return value.getArray();
+    }
+
+    static const std::string& stringOf(const JSONValue& value) {
+        if (!value.isString()) {
+            JSONPARSER_THROW(std::invalid_argument("Expected a string in schema"));
+        }
+        return value.getString();
+    }
+
+    static size_t countOf(const JSONValue& value) {
+        // Integers are parsed as signed and stored as unsigned, so negative ones would wrap around
+        if (!value.isInteger() || static_cast<int64_t>(value.getInteger()) < 0) {
+            JSONPARSER_THROW(std::invalid_argument("Expected a non-negative integer in schema"));
+        }
+        return static_cast<size_t>(value.getInteger());
+    }
+
+    size_t compileNode(const JSONObject& schema) {
+        const auto index = nodes_.size();
+        nodes_.emplace_back();
+        Node node;
+        if (const auto type = schema.getOptValue("type")) {
+            if (type->isString()) {
+                node.types = typeBit(type->getString());
+            } else if (type->isArray()) {
+                node.types = 0;
+                for (const auto& name : type->getArray()) {
+                    node.types |= typeBit(stringOf(name));
+                }
+            } else {
+                JSONPARSER_THROW(std::invalid_argument("Schema type must be a string or an array of strings"));
+            }
+        }
+        if (const auto minimum = schema.getOptValue("minimum")) node.minimum = numberOf(*minimum);
+        if (const auto maximum = schema.getOptValue("maximum")) node.maximum = numberOf(*maximum);
+        if (const auto minLength = schema.getOptValue("minLength")) node.minLength = countOf(*minLength);
+        if (const auto maxLength = schema.getOptValue("maxLength")) node.maxLength = countOf(*maxLength);
+        if (const auto minItems = schema.getOptValue("minItems")) node.minItems = countOf(*minItems);
+        if (const auto maxItems = schema.getOptValue("maxItems")) node.maxItems = countOf(*maxItems);
+        if (const auto enumValues = schema.getOptValue("enum")) {
+            for (const auto& value : arrayOf(*enumValues)) {
+                if (value.isObject() || value.isArray()) {
+                    JSONPARSER_THROW(std::invalid_argument("Only primitive enum values are supported"));
+                }
+                node.enumValues.push_back(value);
+            }
+        }
+        if (const auto items = schema.getOptValue("items")) {
+            node.items = compileNode(objectOf(*items));
+        }
+        if (const auto properties = schema.getOptValue("properties")) {
+            for (const auto& [key, propertySchema] : objectOf(*properties)) {
+                node.properties.push_back(Property{key, compileNode(objectOf(propertySchema)), -1});
+            }
+        }
+        std::sort(node.properties.begin(), node.properties.end(), [](const Property& lhs, const Property& rhs) {
+            return lhs.key < rhs.key;
+        });
+        if (const auto required = schema.getOptValue("required")) {
+            int bit = 0;
+            for (const auto& keyValue : arrayOf(*required)) {
+                if (static_cast<size_t>(bit) == maxRequired) {
+                    JSONPARSER_THROW(std::invalid_argument("Too many required properties"));
+                }
+                const auto& key = stringOf(keyValue);
+                auto it = std::lower_bound(node.properties.begin(), node.properties.end(), key, [](const Property& property, const std::string& k) {
+                    return property.key < k;
+                });
+                if (it == node.properties.end() || it->key != key) {
+                    it = node.properties.insert(it, Property{key, anyNode, -1});
+                }
+                if (it->requiredBit < 0) {
+                    it->requiredBit = bit;
+                    node.requiredMask |= (uint64_t(1) << bit);
+                    ++bit;
+                }
+            }
+        }
+        nodes_[index] = std::move(node);
+        return index;
+    }
+
+    CompiledSchema() { nodes_.emplace_back(); }
+public:
+    static CompiledSchema compile(const JSONObject& schema) {
+        CompiledSchema compiled;
+        compiled.compileNode(schema);
+        return compiled;
+    }
+
+    static CompiledSchema compile(const std::string& schema) {
+        return compile(Parser::parse(schema));
+    }
+
+    const Node& node(size_t index) const { return nodes_[index]; }
+
+    const Property* findProperty(const Node& node, std::string_view key) const {
+        const auto it = std::lower_bound(node.properties.begin(), node.properties.end(), key, [](const Property& property, std::string_view k) {
+            return std::string_view(property.key) < k;
+        });
+        return (it != node.properties.end() && it->key == key) ? &*it : nullptr;
+    }
+};
+
+enum class ViolationPolicy {
+    Collect,
+    AbortOnFirst
+};
+
+struct SchemaParseResult {
+    JSONValue value;
+    std::vector<SchemaViolation> violations;
+
+    bool valid() const { return violations.empty(); }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+// Parses input and checks it against a compiled schema in the same pass, so each value is checked
+// as soon as it is built instead of walking the finished tree again. Syntax errors throw like Parser,
+// so without exceptions they abort; see JSONPARSER_THROW.
+class SchemaParser {
+    struct PathStep {
+        std::string_view key;
+        size_t index;
+    };
+
+    const CompiledSchema& schema_;
+    ViolationPolicy policy_;
+    std::string_view input_;
+    std::vector<PathStep> path_;
+    std::vector<SchemaViolation> violations_;
+
+    SchemaParser(std::string_view input, const CompiledSchema& schema, ViolationPolicy policy):
+        schema_(schema), policy_(policy), input_(input) {}
+
+    // Only built once a violation is found
+    std::string pointer() const {
+        std::string pointer;
+        for (const auto& step : path_) {
+            pointer += '/';
+            if (step.key.data() == nullptr) {
+                pointer += std::to_string(step.index);
+                continue;
+            }
+            for (const char c : step.key) {
+                if (c == '~') {
+                    pointer += "~0";
+                } else if (c == '/') {
+                    pointer += "~1";
+                } else {
+                    pointer += c;
+                }
+            }
+        }
+        return pointer;
+    }
+
+    void report(std::string message) {
+        SchemaViolation violation{pointer(), std::move(message)};
+        if (policy_ == ViolationPolicy::AbortOnFirst) {
+            JSONPARSER_THROW(SchemaViolationError(std::move(violation)));
+        }
+        violations_.push_back(std::move(violation));
+    }
+
+    static uint8_t typeOf(const TokenView& token) {
+        switch (token.type) {
+            case TokenType::Null: return CompiledSchema::NullType;
+            case TokenType::Bool: return CompiledSchema::BooleanType;
+            case TokenType::Int: return CompiledSchema::IntegerType;
+            case TokenType::Double: return CompiledSchema::DoubleType;
+            case TokenType::String: return CompiledSchema::StringType;
+            case TokenType::JsonFormatSpecifier:
+                if (token.value[0] == leftBrace) return CompiledSchema::ObjectType;
+                if (token.value[0] == leftBracket) return CompiledSchema::ArrayType;
+                [[fallthrough]];
+            case TokenType::None:
+                break;
+        }
+        throwError(ErrorCode::ExpectedValue);
+    }
+
+    static double numberOf(const JSONValue& value) {
+        if (value.isDouble()) {
+            return value.getDouble();
+        }
+        return static_cast<double>(static_cast<int64_t>(value.getInteger()));
+    }
+
+    // Whether text starts with a \u escape of a UTF-16 surrogate, D800 to DBFF for high ones and DC00
+    // to DFFF for low ones
+    static bool startsWithSurrogateEscape(std::string_view text, bool high) {
+        if (text.size() < 6 || text[0] != backslash || text[1] != 'u' || (text[2] != 'd' && text[2] != 'D')) {
+            return false;
+        }
+        const auto digit = static_cast<char>(std::tolower(static_cast<unsigned char>(text[3])));
+        return high ? (digit == '8' || digit == '9' || digit == 'a' || digit == 'b') : (digit >= 'c' && digit <= 'f');
+    }
+
+    // Code points of a string token, counting escape sequences, and surrogate pairs of them, as one
+    static size_t lengthOf(std::string_view text) {
+        size_t length = 0;
+        for (size_t i = 0; i < text.size(); ++length) {
+            if (text[i] == backslash && i + 1 < text.size()) {
+                if (startsWithSurrogateEscape(text.substr(i), true) && startsWithSurrogateEscape(text.substr(i + 6), false)) {
+                    i += 12;
+                } else {
+                    i += (text[i + 1] == 'u') ? 6u : 2u;
+                }
+                continue;
+            }
+            // Skip UTF-8 continuation bytes
+            ++i;
+            while (i < text.size() && (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80) {
+                ++i;
+            }
+        }
+        return length;
+    }
+
+    static std::string toString(double number) {
+        std::ostringstream stream;
+        stream << number;
+        return stream.str();
+    }
+
+    static bool equals(const JSONValue& value, const JSONValue& candidate) {
+        if ((value.isDouble() || value.isInteger()) && (candidate.isDouble() || candidate.isInteger())) {
+            return numberOf(value) == numberOf(candidate);
+        }
+        if (value.isString() && candidate.isString()) return value.getString() == candidate.getString();
+        if (value.isBool() && candidate.isBool()) return value.getBool() == candidate.getBool();
+        return value.isNull() && candidate.isNull();
+    }
+
+    void checkPrimitive(const TokenView& token, const JSONValue& value, const CompiledSchema::Node& node) {
+        if (!node.enumValues.empty() &&
+            std::none_of(node.enumValues.begin(), node.enumValues.end(), [&value](const JSONValue& candidate) { return equals(value, candidate); })) {
+            report("Value is not one of the enum values");
+        }
+        if (value.isDouble() || value.isInteger()) {
+            const auto number = numberOf(value);
+            if (node.minimum && number < *node.minimum) {
+                report("Value is less than the minimum " + toString(*node.minimum));
+            }
+            if (node.maximum && number > *node.maximum) {
+                report("Value is greater than the maximum " + toString(*node.maximum));
+            }
+        } else if (value.isString() && (node.minLength > 0 || node.maxLength < std::numeric_limits<size_t>::max())) {
+            const auto length = lengthOf(token.value);
+            if (length < node.minLength) {
+                report("String is shorter than " + std::to_string(node.minLength));
+            }
+            if (length > node.maxLength) {
+                report("String is longer than " + std::to_string(node.maxLength));
+            }
+        }
+    }
+
+    JSONValue parseObject(const CompiledSchema::Node& node) {
+        JSONObject object;
+        uint64_t seenRequired = 0;
+        auto token = Lexer::nextToken(input_);
+        if (!isSpecifier(token, rightBrace)) {
+            while (true) {
+                if (token.type != TokenType::String) {
+                    throwError(ErrorCode::ExpectedKey);
+                }
+                const auto key = token.value;
+                if (!isSpecifier(Lexer::nextToken(input_), colon)) {
+                    throwError(ErrorCode::ExpectedColon);
+                }
+                auto childNode = CompiledSchema::anyNode;
+                if (const auto property = schema_.findProperty(node, key)) {
+                    childNode = property->node;
+                    if (property->requiredBit >= 0) {
+                        seenRequired |= (uint64_t(1) << property->requiredBit);
+                    }
+                }
+                path_.push_back(PathStep{key, 0});
+                auto value = parseValue(Lexer::nextToken(input_), childNode);
+                path_.pop_back();
+                object.setMember(std::string(key), std::move(value));
+                token = Lexer::nextToken(input_);
+                if (isSpecifier(token, rightBrace)) {
+                    break;
+                }
+                if (!isSpecifier(token, comma)) {
+                    throwError(ErrorCode::MissingClosingBracket);
+                }
+                token = Lexer::nextToken(input_);
+            }
+        }
+        if (const auto missing = node.requiredMask & ~seenRequired) {
+            for (const auto& property : node.properties) {
+                if (property.requiredBit >= 0 && (missing & (uint64_t(1) << property.requiredBit))) {
+                    report("Missing required property \"" + property.key + "\"");
+                }
+            }
+        }
+        return JSONValue(std::move(object));
+    }
+
+    JSONValue parseArray(const CompiledSchema::Node& node) {
+        JSONArray array;
+        auto token = Lexer::nextToken(input_);
+        if (!isSpecifier(token, rightBracket)) {
+            while (true) {
+                path_.push_back(PathStep{std::string_view(), array.size()});
+                array.addMember(parseValue(token, node.items));
+                path_.pop_back();
+                token = Lexer::nextToken(input_);
+                if (isSpecifier(token, rightBracket)) {
+                    break;
+                }
+                if (!isSpecifier(token, comma)) {
+                    throwError(ErrorCode::MissingClosingBracket);
+                }
+                token = Lexer::nextToken(input_);
+            }
+        }
+        if (array.size() < node.minItems) {
+            report("Array has fewer than " + std::to_string(node.minItems) + " items");
+        }
+        if (array.size() > node.maxItems) {
+            report("Array has more than " + std::to_string(node.maxItems) + " items");
+        }
+        return JSONValue(std::move(array));
+    }
+
+    JSONValue parseValue(const TokenView& token, size_t nodeIndex) {
+        const auto type = typeOf(token);
+        const auto* node = &schema_.node(nodeIndex);
+        if (!(node->types & type)) {
+            report("Value has the wrong type");
+            // Nothing below a value of the wrong type is checked
+            node = &schema_.node(CompiledSchema::anyNode);
+        }
+        if (type == CompiledSchema::ObjectType) {
+            return parseObject(*node);
+        }
+        if (type == CompiledSchema::ArrayType) {
+            return parseArray(*node);
+        }
+        auto value = Parser::parsePrimitiveToken(token);
+        checkPrimitive(token, value, *node);
+        return value;
+    }
+public:
+    static SchemaParseResult parse(std::string_view input, const CompiledSchema& schema, ViolationPolicy policy = ViolationPolicy::Collect) {
+        SchemaParser parser(input, schema, policy);
+        auto value = parser.parseValue(Lexer::nextToken(parser.input_), CompiledSchema::rootNode);
+        if (Lexer::takeToken(parser.input_).type != TokenType::None) {
+            throwError(ErrorCode::TrailingTokens);
+        }
+        return SchemaParseResult{std::move(value), std::move(parser.violations_)};
+    }
+};
+#pragma clang diagnostic pop
+
+}
+
+#endif /* schema_h */
@@ -0,0 +1,237 @@
+//
+//  shape.hpp
+//  JSONParser
+//
+
+#ifndef shape_h
+#define shape_h
+
+#include "parser.hpp"
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace JSONParser {
+
+struct ShapeStats {
+    // Keys for which a prediction was available, and how many of those were right
+    size_t predictions = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    // Objects whose key sequence differed from the learned one, which was replaced
+    size_t relearned = 0;
+
+    double hitRate() const { return predictions > 0 ? static_cast<double>(hits) / static_cast<double>(predictions) : 0; }
+};
+
+// Key sequences, or shapes, learned per position in the documents parsed by ShapeParser. Positions are
+// paths of keys from the root, with all elements of an array sharing one position. Only the shape of
+// the last object seen at a position is kept. Everything learned is forgotten once more than maxNodes
+// positions are known, which bounds memory when keys keep changing. Not thread safe; use one cache per
+// thread.
+class ShapeCache {
+    friend class ShapeParser;
+
+    struct LearnedKey {
+        // Key as it appears in the input, quotes included, so a prediction is checked with one memcmp
+        std::string quoted;
+        // Position of the member's value
+        size_t node;
+    };
+
+    struct Node {
+        std::vector<LearnedKey> keys;
+        // Position of the elements if the value here is an array
+        size_t elements = noNode;
+        size_t lastArraySize = 0;
+    };
+
+    static constexpr size_t noNode = static_cast<size_t>(-1);
+
+    std::vector<Node> nodes_{Node()};
+    size_t maxNodes_;
+    ShapeStats stats_;
+
+    size_t newNode() {
+        nodes_.emplace_back();
+        return nodes_.size() - 1;
+    }
+
+    size_t elementsOf(size_t node) {
+        if (nodes_[node].elements == noNode) {
+            const auto elements = newNode();
+            nodes_[node].elements = elements;
+        }
+        return nodes_[node].elements;
+    }
+
+    // Position of the value of key, reusing the one learned for the same key if any
+    size_t memberOf(size_t node, std::string_view key) {
+        for (const auto& learned : nodes_[node].keys) {
+            if (std::string_view(learned.quoted).substr(1, learned.quoted.size() - 2) == key) {
+                return learned.node;
+            }
+        }
+        return newNode();
+    }
+
+    void forgetIfFull() {
+        if (nodes_.size() > maxNodes_) {
+            nodes_.assign(1, Node());
+        }
+    }
+public:
+    explicit ShapeCache(size_t maxNodes = 4096): maxNodes_(maxNodes) {}
+
+    const ShapeStats& stats() const { return stats_; }
+
+    void clear() {
+        nodes_.assign(1, Node());
+        stats_ = ShapeStats();
+    }
+};
+
+// Opt-in parser for streams of documents sharing a schema, like Parser::parse otherwise. At each
+// object it predicts the next key from the shape learned at that position and accepts it with a
+// single memcmp; keys that do not match are lexed as usual and the new shape learned. Objects and
+// arrays are reserved to their learned size upfront. Malformed input throws, so without exceptions
+// it aborts; see JSONPARSER_THROW.
+class ShapeParser {
+    ShapeCache& cache_;
+    // Input left to parse
+    std::string_view input_;
+
+    void skipWhitespace() {
+        while (!input_.empty() && std::isspace(input_[0])) {
+            input_.remove_prefix(1);
+        }
+    }
+
+    // Consumes specifier if the input continues with it
+    bool consume(char specifier) {
+        skipWhitespace();
+        if (!input_.empty() && input_[0] == specifier) {
+            input_.remove_prefix(1);
+            return true;
+        }
+        return false;
+    }
+
+    // Consumes the predicted key, quotes included, if the input continues with it
+    bool matchKey(const std::string& quoted) {
+        skipWhitespace();
+        if (input_.size() < quoted.size() || std::memcmp(input_.data(), quoted.data(), quoted.size()) != 0) {
+            return false;
+        }
+        input_.remove_prefix(quoted.size());
+        return true;
+    }
+
+    // Called after the opening brace
+    JSONValue parseObject(size_t node) {
+        auto& stats = cache_.stats_;
+        JSONObject object;
+        object.reserve(cache_.nodes_[node].keys.size());
+        // Keys seen so far, only recorded once the input departs from the learned shape
+        std::vector<ShapeCache::LearnedKey> actualKeys;
+        bool departed = false;
+        size_t index = 0;
+        if (!consume(rightBrace)) {
+            do {
+                // Looked up again for every member, as parsing values may add nodes
+                const auto& learnedKeys = cache_.nodes_[node].keys;
+                const auto predicted = (!departed && index < learnedKeys.size()) ? &learnedKeys[index] : nullptr;
+                stats.predictions += (predicted != nullptr);
+                std::string key;
+                size_t child;
+                if (predicted && matchKey(predicted->quoted)) {
+                    ++stats.hits;
+                    key = predicted->quoted.substr(1, predicted->quoted.size() - 2);
+                    child = predicted->node;
+                } else {
+                    stats.misses += (predicted != nullptr);
+                    if (!departed) {
+                        actualKeys.assign(learnedKeys.begin(), learnedKeys.begin() + static_cast<std::ptrdiff_t>(index));
+                        departed = true;
+                    }
+                    const auto token = Lexer::nextToken(input_);
+                    if (token.type != TokenType::String) {
+                        throwError(ErrorCode::ExpectedKey);
+                    }
+                    key = std::string(token.value);
+                    child = cache_.memberOf(node, token.value);
+                    actualKeys.push_back(ShapeCache::LearnedKey{doubleQuote + key + doubleQuote, child});
+                }
+                ++index;
+                if (!consume(colon)) {
+                    throwError(ErrorCode::ExpectedColon);
+                }
+                object.setMember(key, parseValue(Lexer::nextToken(input_), child));
+            } while (consume(comma));
+            if (!consume(rightBrace)) {
+                throwError(ErrorCode::MissingClosingBracket);
+            }
+        }
+        auto& learnedKeys = cache_.nodes_[node].keys;
+        if (!departed && index < learnedKeys.size()) {
+            // The object ended before the learned shape did
+            actualKeys.assign(learnedKeys.begin(), learnedKeys.begin() + static_cast<std::ptrdiff_t>(index));
+            departed = true;
+        }
+        if (departed) {
+            ++stats.relearned;
+            learnedKeys = std::move(actualKeys);
+        }
+        return JSONValue(std::move(object));
+    }
+
+    // Called after the opening bracket
+    JSONValue parseArray(size_t node) {
+        JSONArray array;
+        array.reserve(cache_.nodes_[node].lastArraySize);
+        const auto elements = cache_.elementsOf(node);
+        if (!consume(rightBracket)) {
+            do {
+                array.addMember(parseValue(Lexer::nextToken(input_), elements));
+            } while (consume(comma));
+            if (!consume(rightBracket)) {
+                throwError(ErrorCode::MissingClosingBracket);
+            }
+        }
+        cache_.nodes_[node].lastArraySize = array.size();
+        return JSONValue(std::move(array));
+    }
+
+    JSONValue parseValue(const TokenView& token, size_t node) {
+        if (isSpecifier(token, leftBrace)) {
+            return parseObject(node);
+        }
+        if (isSpecifier(token, leftBracket)) {
+            return parseArray(node);
+        }
+        return Parser::parsePrimitiveToken(token);
+    }
+
+    ShapeParser(ShapeCache& cache, std::string_view input): cache_(cache), input_(input) {}
+public:
+    static JSONObject parse(std::string_view input, ShapeCache& cache) {
+        cache.forgetIfFull();
+        ShapeParser parser(cache, input);
+        const auto token = Lexer::nextToken(parser.input_);
+        if (!isSpecifier(token, leftBrace)) {
+            throwError(ErrorCode::ExpectedObject);
+        }
+        auto value = parser.parseObject(0);
+        parser.skipWhitespace();
+        if (!parser.input_.empty()) {
+            throwError(ErrorCode::TrailingTokens);
+        }
+        return std::move(value.getObject());
+    }
+};
+
+}
+
+#endif /* shape_h */
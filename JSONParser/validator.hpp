@@ -0,0 +1,292 @@
+//
+//  validator.hpp
+//  JSONParser
+//
+
+#ifndef validator_h
+#define validator_h
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+namespace JSONParser {
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+struct ValidationResult {
+    bool valid;
+    // Byte offset of the first offending character, or the input size for valid inputs
+    size_t offset;
+    // Static string describing the error, or nullptr for valid inputs
+    const char* reason;
+
+    explicit operator bool() const noexcept { return valid; }
+};
+#pragma clang diagnostic pop
+
+// Checks input against the full RFC 8259 grammar without building any values or allocating: escapes,
+// UTF-8 encoding of strings and number syntax are all verified. Unlike Parser::parse, any value is
+// accepted at the top level. Unpaired surrogate escapes are accepted, as the grammar allows them.
+class Validator {
+    static constexpr size_t maxDepth = 1024;
+
+    static constexpr bool isWhitespace(unsigned char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    static constexpr bool isDigit(unsigned char c) noexcept {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr bool isHexDigit(unsigned char c) noexcept {
+        return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    static constexpr bool isContinuation(unsigned char c) noexcept {
+        return (c & 0xC0) == 0x80;
+    }
+
+    static size_t skipWhitespace(std::string_view input, size_t pos) noexcept {
+        while (pos < input.size() && isWhitespace(static_cast<unsigned char>(input[pos]))) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // Validates one UTF-8 sequence starting with a non-ASCII byte at pos and moves past it
+    static const char* scanUtf8(std::string_view input, size_t& pos) noexcept {
+        const auto byteAt = [&input](size_t i) {
+            return static_cast<unsigned char>(i < input.size() ? input[i] : '\0');
+        };
+        const auto lead = byteAt(pos);
+        size_t length;
+        unsigned char secondMin = 0x80, secondMax = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            // No overlong encodings and no UTF-16 surrogates
+            if (lead == 0xE0) secondMin = 0xA0;
+            if (lead == 0xED) secondMax = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            // No overlong encodings and nothing above U+10FFFF
+            if (lead == 0xF0) secondMin = 0x90;
+            if (lead == 0xF4) secondMax = 0x8F;
+        } else {
+            return "Invalid UTF-8 lead byte";
+        }
+        const auto second = byteAt(pos + 1);
+        if (second < secondMin || second > secondMax) {
+            return "Invalid UTF-8 sequence";
+        }
+        for (size_t i = 2; i < length; ++i) {
+            if (!isContinuation(byteAt(pos + i))) {
+                pos += i;
+                return "Invalid UTF-8 sequence";
+            }
+        }
+        pos += length;
+        return nullptr;
+    }
+
+    // pos points at the opening quote, and is moved past the closing one
+    static const char* scanString(std::string_view input, size_t& pos) noexcept {
+        ++pos;
+        while (pos < input.size()) {
+            const auto c = static_cast<unsigned char>(input[pos]);
+            if (c == '"') {
+                ++pos;
+                return nullptr;
+            }
+            if (c < 0x20) {
+                return "Unescaped control character in string";
+            }
+            if (c >= 0x80) {
+                if (const auto error = scanUtf8(input, pos)) {
+                    return error;
+                }
+                continue;
+            }
+            if (c != '\\') {
+                ++pos;
+                continue;
+            }
+            if (++pos == input.size()) {
+                break;
+            }
+            switch (input[pos]) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    ++pos;
+                    break;
+                case 'u':
+                    for (int i = 0; i < 4; ++i) {
+                        if (++pos == input.size()) {
+                            return "Unterminated string";
+                        }
+                        if (!isHexDigit(static_cast<unsigned char>(input[pos]))) {
+                            return "Invalid unicode escape";
+                        }
+                    }
+                    ++pos;
+                    break;
+                default:
+                    return "Invalid escape sequence";
+            }
+        }
+        return "Unterminated string";
+    }
+
+    static const char* scanNumber(std::string_view input, size_t& pos) noexcept {
+        const auto digitAt = [&input](size_t i) {
+            return i < input.size() && isDigit(static_cast<unsigned char>(input[i]));
+        };
+        if (input[pos] == '-') {
+            ++pos;
+        }
+        if (!digitAt(pos)) {
+            return "Expected digit";
+        }
+        if (input[pos] == '0') {
+            ++pos;
+            if (digitAt(pos)) {
+                return "Leading zero in number";
+            }
+        } else {
+            while (digitAt(pos)) ++pos;
+        }
+        if (pos < input.size() && input[pos] == '.') {
+            ++pos;
+            if (!digitAt(pos)) {
+                return "Expected digit after decimal point";
+            }
+            while (digitAt(pos)) ++pos;
+        }
+        if (pos < input.size() && (input[pos] == 'e' || input[pos] == 'E')) {
+            ++pos;
+            if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) {
+                ++pos;
+            }
+            if (!digitAt(pos)) {
+                return "Expected digit in exponent";
+            }
+            while (digitAt(pos)) ++pos;
+        }
+        return nullptr;
+    }
+
+    static const char* scanLiteral(std::string_view input, size_t& pos, std::string_view literal) noexcept {
+        if (input.compare(pos, literal.size(), literal) != 0) {
+            return "Invalid literal";
+        }
+        pos += literal.size();
+        return nullptr;
+    }
+
+    // Moves past an object key and the colon following it
+    static const char* scanKey(std::string_view input, size_t& pos) noexcept {
+        if (pos == input.size() || input[pos] != '"') {
+            return "Expected object key";
+        }
+        if (const auto error = scanString(input, pos)) {
+            return error;
+        }
+        pos = skipWhitespace(input, pos);
+        if (pos == input.size() || input[pos] != ':') {
+            return "Expected ':' after object key";
+        }
+        pos = skipWhitespace(input, pos + 1);
+        return nullptr;
+    }
+public:
+    static ValidationResult validate(std::string_view input) noexcept {
+        // Whether each open container is an object
+        bool isObject[maxDepth];
+        size_t depth = 0;
+        size_t pos = skipWhitespace(input, 0);
+        const char* error = nullptr;
+        const auto fail = [&pos](const char* reason) {
+            return ValidationResult{false, pos, reason};
+        };
+
+        while (true) {
+            // Expecting a value at pos
+            if (pos == input.size()) {
+                return fail("Unexpected end of input");
+            }
+            bool valueComplete = true;
+            switch (input[pos]) {
+                case '{':
+                case '[':
+                    if (depth == maxDepth) {
+                        return fail("Nesting too deep");
+                    }
+                    isObject[depth++] = (input[pos] == '{');
+                    pos = skipWhitespace(input, pos + 1);
+                    if (pos < input.size() && input[pos] == (isObject[depth - 1] ? '}' : ']')) {
+                        --depth;
+                        ++pos;
+                    } else {
+                        valueComplete = false;
+                        if (isObject[depth - 1]) {
+                            error = scanKey(input, pos);
+                        }
+                    }
+                    break;
+                case '"':
+                    error = scanString(input, pos);
+                    break;
+                case 't':
+                    error = scanLiteral(input, pos, "true");
+                    break;
+                case 'f':
+                    error = scanLiteral(input, pos, "false");
+                    break;
+                case 'n':
+                    error = scanLiteral(input, pos, "null");
+                    break;
+                default:
+                    if (input[pos] == '-' || isDigit(static_cast<unsigned char>(input[pos]))) {
+                        error = scanNumber(input, pos);
+                    } else {
+                        error = "Unexpected character";
+                    }
+            }
+            if (error) {
+                return fail(error);
+            }
+
+            // Close as many containers as the input does, until another value is expected
+            while (valueComplete) {
+                pos = skipWhitespace(input, pos);
+                if (depth == 0) {
+                    if (pos != input.size()) {
+                        return fail("Unexpected characters after the value");
+                    }
+                    return ValidationResult{true, pos, nullptr};
+                }
+                if (pos == input.size()) {
+                    return fail("Unexpected end of input");
+                }
+                const char c = input[pos];
+                if (c == ',') {
+                    pos = skipWhitespace(input, pos + 1);
+                    if (isObject[depth - 1] && (error = scanKey(input, pos))) {
+                        return fail(error);
+                    }
+                    valueComplete = false;
+                } else if (c == (isObject[depth - 1] ? '}' : ']')) {
+                    --depth;
+                    ++pos;
+                } else {
+                    return fail(isObject[depth - 1] ? "Expected ',' or '}'" : "Expected ',' or ']'");
+                }
+            }
+        }
+    }
+};
+
+}
+
+#endif /* validator_h */
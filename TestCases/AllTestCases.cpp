@@ -7,7 +7,24 @@
 
 #include "AllTestCases.hpp"
 #include "lexer.hpp"
+#include "parser.hpp"
+#include "binary.hpp"
+#include "cache.hpp"
+#include "incremental.hpp"
+#include "immutable.hpp"
+#include "parallel.hpp"
+#include "validator.hpp"
+#include "formatter.hpp"
+#include "async_parser.hpp"
+#include "schema.hpp"
+#include "columnar.hpp"
+#include "shape.hpp"
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <thread>
 #include <iostream>
+#include <unistd.h>
 
 using namespace std;
 using namespace JSONParser;
@@ -218,6 +235,688 @@ void lexEverything() {
 //    print(Lexer::lex("1.0null4.3true\"wow, lol.g agnonn\"falsetrue"));
 }
 
+static const char sampleRecord[] = "{\r\n    \"_id\": \"604e253c88e106cadf9e015d\",\r\n    \"index\": 0,\r\n    \"isActive\": false,\r\n    \"balance\": \"$3,487.22\",\r\n    \"age\": 40,\r\n    \"name\": \"Felicia Kirk\",\r\n    \"latitude\": 26.21621,\r\n    \"longitude\": 25.728831,\r\n    \"tags\": [\"nisi\", \"qui\", \"esse\"],\r\n    \"friends\": [\r\n      {\r\n        \"id\": 0,\r\n        \"name\": \"Marissa Wells\"\r\n      },\r\n      {\r\n        \"id\": 1,\r\n        \"name\": \"Coleen Parks\"\r\n      }\r\n    ],\r\n    \"favoriteFruit\": \"banana\"\r\n  }";
+
+// Documents for the streaming readers, with numbers that lex differently when cut short before a dot,
+// exponent or exponent sign
+static const char* const streamingFixtures[] = {
+    sampleRecord,
+    "{\"lat\": 26.21621, \"n\": 2e5, \"small\": -2E-10, \"big\": 1.5e+3, \"values\": [0, -0.25, true, false, null, \"}\", {}, []]}",
+    "[             1.5]",
+    "2e10",
+    "2e-10",
+    "-0.5",
+    "null"
+};
+
+std::string generateRecords(int numRecords) {
+    std::string s = "{\"records\": [";
+    for (int i = 0; i < numRecords; ++i) {
+        if (i > 0) {
+            s += ",";
+        }
+        s += sampleRecord;
+    }
+    s += "]}";
+    return s;
+}
+
+void binaryRoundTrip() {
+    const auto object = Parser::parse(sampleRecord);
+    const auto encoded = BinaryEncoder::encode(object);
+    cout<< "Binary round trip: "<< BinaryValue::root(encoded).toJSONValue()<< "\n";
+}
+
+void binaryInPlaceRead() {
+    const auto encoded = BinaryEncoder::encode(Parser::parse(sampleRecord));
+    const auto root = BinaryValue::root(encoded);
+    cout<< "Binary name: "<< root.getValue("name").getString()
+        << ", age: "<< root.getValue("age").getInteger()
+        << ", second friend: "<< root.getValue("friends")[1].getValue("name").getString()
+        << ", has car: "<< root.exists("car")<< "\n";
+}
+
+void binaryRejectsGarbage() {
+    try {
+        BinaryValue::root("{\"name\": 1}");
+        cout<< "Binary garbage accepted\n";
+    } catch (const std::invalid_argument& e) {
+        cout<< "Binary garbage rejected: "<< e.what()<< "\n";
+    }
+}
+
+void binaryMappedRead() {
+    const auto object = Parser::parse(sampleRecord);
+    const auto encoded = BinaryEncoder::encode(object);
+    char path[] = "/tmp/JSONParserTestXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0 || write(fd, encoded.data(), encoded.size()) != static_cast<ssize_t>(encoded.size())) {
+        cout<< "Cannot write a temporary file\n";
+        return;
+    }
+    {
+        const MappedFile mapped(path);
+        const auto root = BinaryValue::root(mapped.data());
+        cout<< "Mapped name: "<< root.getValue("name").getString()
+            << ", age: "<< root.getValue("age").getInteger()
+            << ", second friend: "<< root.getValue("friends")[1].getValue("name").getString()
+            << ", decodes to the document: "<< (BinaryEncoder::encode(root.toJSONValue()) == BinaryEncoder::encode(JSONValue(object)))<< "\n";
+    }
+    if (ftruncate(fd, 0) != 0) {
+        cout<< "Cannot truncate a temporary file\n";
+        return;
+    }
+    close(fd);
+    try {
+        const MappedFile mapped(path);
+        cout<< "Mapped empty file size: "<< mapped.data().size()<< "\n";
+        BinaryValue::root(mapped.data());
+        cout<< "Mapped empty file accepted\n";
+    } catch (const std::invalid_argument& e) {
+        cout<< "Mapped empty file rejected: "<< e.what()<< "\n";
+    }
+    unlink(path);
+    try {
+        const MappedFile mapped(path);
+        cout<< "Mapped missing file accepted\n";
+    } catch (const std::system_error& e) {
+        cout<< "Mapped missing file rejected, no such file: "<< (e.code() == std::errc::no_such_file_or_directory)<< "\n";
+    }
+}
+
+void printCacheStats(ParseCache& cache) {
+    const auto stats = cache.stats();
+    cout<< "hits: "<< stats.hits<< ", misses: "<< stats.misses<< ", evictions: "<< stats.evictions
+        << ", entries: "<< stats.entries<< "\n";
+}
+
+void cacheSharesDocuments() {
+    ParseCache cache(1 << 20);
+    const auto first = cache.parse(sampleRecord);
+    const auto second = cache.parse(sampleRecord);
+    cout<< "Cache shares documents: "<< (first == second)<< ", ";
+    printCacheStats(cache);
+}
+
+void cacheEvictsLeastRecentlyUsed() {
+    ParseCache cache(8 * 1024, 1);
+    const auto small = generateRecords(1);
+    const auto big = generateRecords(2);
+    cache.parse(small);
+    cache.parse(big);
+    cache.parse(generateRecords(3));
+    cout<< "Cache after eviction: ";
+    printCacheStats(cache);
+}
+
+void cacheRefreshesRecency() {
+    // Records of the same size, so that the cache holds three of them
+    std::vector<std::string> records;
+    for (const char name : {'A', 'B', 'C', 'D'}) {
+        auto record = std::string(sampleRecord);
+        record.replace(record.find("Kirk"), 4, std::string("Kir") + name);
+        records.push_back(record);
+    }
+    ParseCache probe(1 << 20, 1);
+    probe.parse(records[0]);
+    ParseCache cache(probe.stats().memoryUsage * 7 / 2, 1);
+    cache.parse(records[0]);
+    cache.parse(records[1]);
+    cache.parse(records[2]);
+    // Touching A leaves B the least recently used
+    cache.parse(records[0]);
+    cache.parse(records[3]);
+    cout<< "Cache after touching A and adding D holds A: "<< cache.contains(records[0])<< ", B: "<< cache.contains(records[1])
+        << ", C: "<< cache.contains(records[2])<< ", D: "<< cache.contains(records[3])<< ", ";
+    printCacheStats(cache);
+    assert(!cache.contains(records[1]));
+    assert(cache.contains(records[0]) && cache.contains(records[2]) && cache.contains(records[3]));
+}
+
+void applyEdit(const std::string& name, std::string& source, JSONObject& document, const TextEdit& edit) {
+    try {
+        const bool incremental = IncrementalParser::reparse(document, source, edit);
+        const bool matchesFullParse = (BinaryEncoder::encode(document) == BinaryEncoder::encode(Parser::parse(source)));
+        cout<< name<< " incremental: "<< incremental<< ", matches full parse: "<< matchesFullParse<< "\n";
+    } catch (const std::exception& e) {
+        cout<< name<< " rejected: "<< e.what()<< "\n";
+    }
+}
+
+void reparseEdits() {
+    std::string source = sampleRecord;
+    auto document = Parser::parse(source);
+    const auto friendName = source.find("Coleen");
+    applyEdit("Rename friend", source, document, TextEdit{friendName, 6, "Colleen"});
+    const auto tag = source.find("\"qui\"");
+    applyEdit("Replace tag", source, document, TextEdit{tag, 5, "\"quo\", [1, 2]"});
+    const auto age = source.find("40");
+    applyEdit("Change age", source, document, TextEdit{age, 2, "41"});
+    const auto friendsEnd = source.find("]", source.find("friends"));
+    applyEdit("Break structure", source, document, TextEdit{friendsEnd, 1, ""});
+    cout<< "Edited document: "<< document.getValue("friends")<< " "<< document.getValue("tags")<< "\n";
+}
+
+void reparseIndexedEdits() {
+    IncrementalParser parser(generateRecords(1000));
+    const auto indexingTokens = parser.tokensLexed();
+    const auto lastFriend = parser.source().rfind("Coleen");
+    const bool incremental = parser.apply(TextEdit{lastFriend, 6, "Colleen"});
+    const auto editTokens = parser.tokensLexed() - indexingTokens;
+    cout<< "Edit near the end incremental: "<< incremental<< ", tokens lexed: "<< editTokens<< " of "<< indexingTokens
+        << ", matches full parse: "<< (BinaryEncoder::encode(parser.document()) == BinaryEncoder::encode(Parser::parse(parser.source())))<< "\n";
+    assert(editTokens < 10);
+
+    // Random edits, most of which break the document, checking the index stays in sync with the source.
+    // Inserted strings are numbered to keep object keys unique.
+    std::minstd_rand random(1);
+    static const char* const insertions[] = {"", "1", "-2.5e3", "\"x", "\"k", ", 4", "[", "]", "{}", "[true]", "\""};
+    size_t applied = 0;
+    size_t mismatches = 0;
+    IncrementalParser small(sampleRecord);
+    for (int i = 0; i < 5000; ++i) {
+        const auto offset = random() % (small.source().size() + 1);
+        const auto removedLength = std::min<size_t>(random() % 4, small.source().size() - offset);
+        try {
+            std::string insertion = insertions[random() % std::size(insertions)];
+            if (insertion == "\"x") {
+                insertion += std::to_string(i) + "\"";
+            } else if (insertion == "\"k") {
+                insertion += std::to_string(i) + "\": 3, ";
+            }
+            small.apply(TextEdit{offset, removedLength, insertion});
+        } catch (const std::exception&) {
+            continue;
+        }
+        ++applied;
+        mismatches += (BinaryEncoder::encode(small.document()) != BinaryEncoder::encode(Parser::parse(small.source())));
+    }
+    cout<< "Random edits applied: "<< applied<< ", mismatches: "<< mismatches<< "\n";
+}
+
+void immutableSnapshots() {
+    const ImmutableValue snapshot(JSONValue(Parser::parse(sampleRecord)));
+    const auto copy = snapshot;
+    const auto renamed = snapshot.setIn({"friends", size_t(1), "name"}, "Colleen Parks");
+    cout<< "Snapshot copy shares root: "<< copy.sharesNodeWith(snapshot)
+        << ", snapshot name: "<< snapshot.getIn({"friends", size_t(1), "name"}).getString()
+        << ", new name: "<< renamed.getIn({"friends", size_t(1), "name"}).getString()
+        << ", tags shared: "<< renamed.getObject().getValue("tags").sharesNodeWith(snapshot.getObject().getValue("tags"))
+        << ", first friend shared: "<< renamed.getIn({"friends", size_t(0)}).sharesNodeWith(snapshot.getIn({"friends", size_t(0)}))
+        << ", friends shared: "<< renamed.getIn({"friends"}).sharesNodeWith(snapshot.getIn({"friends"}))<< "\n";
+}
+
+void parallelTraversal() {
+    const auto document = Parser::parse(generateRecords(5000));
+    const auto recordsValue = document.getValue("records");
+    const auto& records = recordsValue.getArray();
+    TaskPool pool(4);
+    const auto totalAge = parallelMapReduce(pool, records, uint64_t(0), [](const JSONValue& record) {
+        return record.getObject().getValue("age").getInteger();
+    }, [](uint64_t lhs, uint64_t rhs) { return lhs + rhs; });
+    std::vector<std::string> names(records.size());
+    parallelForEach(pool, records, [&names](const JSONValue& record, size_t i) {
+        names[i] = record.getObject().getValue("name").getString();
+    });
+    std::atomic<size_t> numNodes{0};
+    parallelVisit(pool, JSONValue(document), [&numNodes](const JSONValue&) { ++numNodes; });
+    cout<< "Parallel total age: "<< totalAge<< ", last name: "<< names.back()<< ", nodes: "<< numNodes<< "\n";
+}
+
+void validate(const std::string& input) {
+    const auto result = Validator::validate(input);
+    cout<< "Validate "<< input<< ": ";
+    if (result) {
+        cout<< "valid\n";
+    } else {
+        cout<< result.reason<< " at "<< result.offset<< "\n";
+    }
+}
+
+void validateInputs() {
+    validate(sampleRecord);
+    validate("[1, -0.5e+10, \"tab\\t\\u00e9\", \"\xc3\xa9\", true, false, null, {}]");
+    validate("{\"a\": 01}");
+    validate("{\"a\": 1.}");
+    validate("{\"a\": [1, 2,]}");
+    validate("{\"a\" 1}");
+    validate("{\"a\": \"\\x\"}");
+    validate("{\"a\": \"\xc0\xaf\"}");
+    validate("{\"a\": \"\xed\xa0\x80\"}");
+    validate("{\"a\": tru}");
+    validate("{\"a\": {\"b\": [1, 2]}");
+    validate("{} {}");
+}
+
+void formatDocuments() {
+    const std::string input = "{\"b\": [1, -2.5e10, {}, []], \"a\": {\"quote\": \"say \\\"hi\\\"\", \"empty\": \"\"}}\n{\"next\": true}";
+    cout<< "Minified: "<< Formatter::minify(input)<< "\n";
+    cout<< "Pretty printed: "<< Formatter::prettyPrint(input)<< "\n";
+
+    // Tiny chunks make tokens straddle chunk boundaries
+    FILE* file = tmpfile();
+    const auto record = std::string(sampleRecord);
+    fwrite(record.data(), 1, record.size(), file);
+    fflush(file);
+    rewind(file);
+    FdTokenReader reader(fileno(file), 16);
+    std::string output;
+    StringSink sink(output);
+    Formatter::format(reader, sink);
+    fclose(file);
+    cout<< "Chunked minify matches: "<< (output == Formatter::minify(record))<< "\n";
+}
+
+std::string formatThroughFd(const std::string& input, size_t chunkSize, FormatStyle style) {
+    FILE* file = tmpfile();
+    fwrite(input.data(), 1, input.size(), file);
+    fflush(file);
+    rewind(file);
+    FdTokenReader reader(fileno(file), chunkSize);
+    std::string output;
+    StringSink sink(output);
+    try {
+        Formatter::format(reader, sink, style);
+    } catch (const std::exception& e) {
+        output = e.what();
+    }
+    fclose(file);
+    return output;
+}
+
+void formatInChunks() {
+    for (const auto chunkSize : {size_t(1), size_t(2), size_t(16)}) {
+        size_t matches = 0;
+        for (const auto fixture : streamingFixtures) {
+            matches += (formatThroughFd(fixture, chunkSize, FormatStyle::Minified) == Formatter::minify(fixture));
+            matches += (formatThroughFd(fixture, chunkSize, FormatStyle::Indented) == Formatter::prettyPrint(fixture));
+        }
+        cout<< "Formatted in "<< chunkSize<< " byte chunks match: "<< matches<< " of "<< 2 * std::size(streamingFixtures)<< "\n";
+    }
+}
+
+// A malformed stream should fail within a few chunks instead of being read into memory first
+void formatRejectsEarly() {
+    std::string tail;
+    for (int i = 0; i < 100000; ++i) {
+        tail += "2, ";
+    }
+    tail += "3]";
+    size_t rejectedEarly = 0;
+    const char* const strays[] = {"x", "tx", "-a", "nulL", "[1}"};
+    for (const auto stray : strays) {
+        const auto input = "[1, " + std::string(stray) + ", " + tail;
+        FILE* file = tmpfile();
+        fwrite(input.data(), 1, input.size(), file);
+        fflush(file);
+        rewind(file);
+        FdTokenReader reader(fileno(file), 16);
+        std::string output;
+        StringSink sink(output);
+        try {
+            Formatter::format(reader, sink);
+        } catch (const std::exception&) {
+            rejectedEarly += (lseek(fileno(file), 0, SEEK_CUR) <= 32);
+        }
+        fclose(file);
+    }
+    cout<< "Formatter rejected malformed streams within 32 bytes: "<< rejectedEarly<< " of "<< std::size(strays)<< "\n";
+}
+
+static const char recordSchema[] = "{\"type\": \"object\", \"required\": [\"name\", \"age\", \"isActive\"], \"properties\": {"
+    "\"name\": {\"type\": \"string\", \"minLength\": 1}, "
+    "\"age\": {\"type\": \"integer\", \"minimum\": 18, \"maximum\": 130}, "
+    "\"isActive\": {\"type\": \"boolean\"}, "
+    "\"latitude\": {\"type\": \"number\", \"minimum\": -90, \"maximum\": 90}, "
+    "\"favoriteFruit\": {\"enum\": [\"apple\", \"banana\", \"strawberry\"]}, "
+    "\"tags\": {\"type\": \"array\", \"items\": {\"type\": \"string\"}, \"maxItems\": 5}, "
+    "\"friends\": {\"type\": \"array\", \"items\": {\"type\": \"object\", \"required\": [\"id\", \"name\"]}}}}";
+
+void schemaParse(const std::string& name, const std::string& input, const CompiledSchema& schema) {
+    const auto result = SchemaParser::parse(input, schema);
+    cout<< name<< " schema violations: "<< result.violations.size();
+    for (const auto& violation : result.violations) {
+        cout<< ", "<< violation.pointer<< ": "<< violation.message;
+    }
+    cout<< "\n";
+}
+
+void validateAgainstSchema() {
+    const auto schema = CompiledSchema::compile(recordSchema);
+    schemaParse("Valid record", sampleRecord, schema);
+    schemaParse("Invalid record", "{\"name\": \"\", \"age\": 12.5, \"latitude\": -91, \"favoriteFruit\": \"kiwi\", "
+                "\"tags\": [\"a\", 1], \"friends\": [{\"id\": 0}, {\"name\": \"x\"}]}", schema);
+    try {
+        SchemaParser::parse("{\"name\": \"Kid\", \"age\": 7, \"isActive\": true, \"tags\": 1}", schema, ViolationPolicy::AbortOnFirst);
+        cout<< "Schema abort accepted\n";
+    } catch (const SchemaViolationError& e) {
+        cout<< "Schema abort: "<< e.what()<< "\n";
+    }
+}
+
+void rejectMalformedSchemas() {
+    const char* const schemas[] = {
+        "{\"type\": \"string\", \"maxLength\": -1}",
+        "{\"type\": \"object\", \"properties\": []}",
+        "{\"type\": \"object\", \"properties\": {\"a\": 1}}",
+        "{\"type\": \"array\", \"items\": \"string\"}",
+        "{\"type\": \"object\", \"required\": \"a\"}",
+        "{\"type\": [\"string\", 1]}"
+    };
+    for (const auto schema : schemas) {
+        try {
+            CompiledSchema::compile(std::string(schema));
+            cout<< "Malformed schema accepted: "<< schema<< "\n";
+        } catch (const std::invalid_argument& e) {
+            cout<< "Malformed schema rejected: "<< e.what()<< "\n";
+        }
+    }
+}
+
+// A surrogate pair escape is one character
+void schemaCountsSurrogatePairs() {
+    const std::string emoji = "\"\\ud83d\\ude00\"";
+    schemaParse("Surrogate pair with maxLength 1", emoji, CompiledSchema::compile(std::string("{\"maxLength\": 1}")));
+    schemaParse("Surrogate pair with minLength 2", emoji, CompiledSchema::compile(std::string("{\"minLength\": 2}")));
+    schemaParse("Lone surrogates with maxLength 1", "\"\\ud83d\\u0041\"", CompiledSchema::compile(std::string("{\"maxLength\": 1}")));
+}
+
+std::string generateNDJSON(int numRecords) {
+    std::string s;
+    for (int i = 0; i < numRecords; ++i) {
+        s += Formatter::minify(sampleRecord);
+        s += "\n";
+    }
+    return s;
+}
+
+void printColumn(const Column& column) {
+    cout<< column.path()<< " ("<< column.nullCount()<< " null): ";
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (!column.isValid(row)) {
+            cout<< "null ";
+            continue;
+        }
+        switch (column.type()) {
+            case ColumnType::Int64: cout<< column.int64Values()[row]<< " "; break;
+            case ColumnType::Double: cout<< column.doubleValues()[row]<< " "; break;
+            case ColumnType::Bool: cout<< column.boolValue(row)<< " "; break;
+            case ColumnType::String: cout<< column.stringValue(row)<< " "; break;
+        }
+    }
+    cout<< "\n";
+}
+
+void extractColumns() {
+    ColumnarExtractor extractor({
+        {"age", ColumnType::Int64},
+        {"balance", ColumnType::String},
+        {"latitude", ColumnType::Double},
+        {"isActive", ColumnType::Bool},
+        {"location.lat", ColumnType::Double}
+    });
+    extractor.append(generateNDJSON(2));
+    extractor.append("{\"age\": \"old\", \"age\": -3, \"location\": {\"lat\": 1, \"tags\": [{}]}, \"isActive\": null}\n"
+                     "{\"latitude\": 2.5e1, \"location\": [1], \"balance\": \"$0\"}");
+    try {
+        extractor.append("{\"age\": 1, \"balance\": ");
+    } catch (const std::invalid_argument& e) {
+        cout<< "Columnar truncated record rejected: "<< e.what()<< "\n";
+    }
+    cout<< "Columnar rows: "<< extractor.numRows()<< "\n";
+    for (const auto& column : extractor.columns()) {
+        printColumn(column);
+    }
+}
+
+// Malformed records, including in members that are only skipped, fail like they do with Parser
+void extractColumnsRejects() {
+    const char* const malformed[] = {
+        "{\"x\": [1}, \"age\": 3}",
+        "{\"x\": :, \"age\": 3}",
+        "{\"age\": ,, \"y\": 1}",
+        "{\"x\": {\"a\" 1 2]}",
+        "{\"x\": [1 2], \"age\": 3}",
+        "{\"x\": [1, ], \"age\": 3}",
+        "{\"x\": {\"a\": 1, }, \"age\": 3}",
+        "{\"x\": {3: 1}, \"age\": 3}",
+        "{\"latitude\": 1e999}",
+        "{\"age\": 99999999999999999999}"
+    };
+    size_t matches = 0;
+    for (const auto record : malformed) {
+        ColumnarExtractor extractor({{"age", ColumnType::Int64}, {"latitude", ColumnType::Double}});
+        std::string message = "accepted";
+        try {
+            extractor.append(record);
+        } catch (const std::exception& e) {
+            message = e.what();
+        }
+        const auto parsed = Parser::tryParse(record);
+        matches += (!parsed && message == parsed.error().message() && extractor.numRows() == 0);
+    }
+    cout<< "Columnar rejects malformed records like Parser: "<< matches<< " of "<< std::size(malformed)<< "\n";
+}
+
+static constexpr JSONKey nameKey("name");
+static constexpr JSONKey ageKey("age");
+static constexpr JSONKey carKey("car");
+
+void lookupByKey() {
+    static_assert(ageKey.hash() == hashKey("age"), "Key hashes are computed at compile time");
+    const auto object = Parser::parse(sampleRecord);
+    cout<< "Key lookup name: "<< object.getValue(nameKey)<< ", age: "<< object.getValue(ageKey).getInteger()
+        << ", has car: "<< object.exists(carKey)<< ", car: "<< object.getOptValue(carKey).has_value()<< "\n";
+    try {
+        object.getValue(carKey);
+        cout<< "Key lookup found missing member\n";
+    } catch (const std::out_of_range& e) {
+        cout<< "Key lookup rejected: "<< e.what()<< "\n";
+    }
+}
+
+void shapeParse(const std::string& name, const std::string& input, ShapeCache& cache) {
+    const auto object = ShapeParser::parse(input, cache);
+    const auto& stats = cache.stats();
+    cout<< name<< " matches: "<< (BinaryEncoder::encode(object) == BinaryEncoder::encode(Parser::parse(input)))
+        << ", predictions: "<< stats.predictions<< ", hits: "<< stats.hits<< ", misses: "<< stats.misses
+        << ", relearned: "<< stats.relearned<< "\n";
+}
+
+void learnShapes() {
+    ShapeCache cache;
+    shapeParse("First shape", sampleRecord, cache);
+    shapeParse("Same shape", sampleRecord, cache);
+    shapeParse("Reordered shape", "{\"index\": 1, \"_id\": \"x\", \"tags\": [\"a\"], \"friends\": [{\"name\": \"y\", \"id\": 2}, {\"id\": 3}]}", cache);
+    shapeParse("Original shape", sampleRecord, cache);
+    try {
+        ShapeParser::parse("{\"_id\": \"x\", \"index\" 0}", cache);
+        cout<< "Shape parse accepted missing colon\n";
+    } catch (const std::invalid_argument& e) {
+        cout<< "Shape parse rejected: "<< e.what()<< "\n";
+    }
+    cout<< "Shape hit rate: "<< cache.stats().hitRate()<< "\n";
+}
+
+void tryParse(const std::string& input) {
+    const auto result = Parser::tryParse(input);
+    cout<< "Try parse "<< input<< ": ";
+    if (result) {
+        cout<< result->size()<< " members\n";
+    } else {
+        const auto& error = result.error();
+        cout<< error.message()<< " at "<< error.offset<< " (line "<< error.line<< ", column "<< error.column<< ")\n";
+    }
+}
+
+void parseRejects(const std::string& input, const std::string& expectedMessage) {
+    try {
+        Parser::parse(input);
+        cout<< "Parse accepted "<< input<< "\n";
+    } catch (const std::exception& e) {
+        cout<< "Parse rejected "<< input<< ": "<< e.what()<< "\n";
+        assert(e.what() == expectedMessage);
+    }
+}
+
+void parseErrorMessages() {
+    parseRejects("{1: 2}", "Expected object key");
+    parseRejects("{\"a\":", "No right bracket in the input");
+    parseRejects("{\"a\" 2}", "Expected colon after object key");
+    parseRejects("{\"a\": 99999999999999999999}", "Number out of range");
+    parseRejects("{\"a\": 1}}", "Unexpected tokens after the value");
+    parseRejects("{\"a\": [1 2]}", "No right bracket in the input");
+    parseRejects("[1, 2]", "Unable to parse the input string");
+}
+
+void parseWithoutExceptions() {
+    tryParse("{\"a\": {}, \"b\": [], \"}\": [{}]}");
+    tryParse("{\n  \"a\": 1,\n  \"b\" 2\n}");
+    tryParse("{\"a\": \"unterminated}");
+    tryParse("{\"a\": 1e999}");
+    tryParse("{\"a\": [1, 2}");
+    tryParse("{\"a\": 1} x");
+    tryParse("{\"a\": 1} 2");
+    tryParse("[1, 2]");
+    const auto value = Parser::tryParseValue("[1, 2]");
+    cout<< "Try parse value: "<< value->getArray().size()<< " elements\n";
+}
+
+#ifdef JSONPARSER_HAS_COROUTINES
+// Hands out the input a few bytes at a time, completing every read right away
+struct MockReader {
+    std::string_view input;
+    size_t maxChunkSize;
+    // Reads stop at this many bytes into the input once, if set
+    size_t splitAt = 0;
+    
+    struct ReadAwaiter {
+        size_t size;
+        bool await_ready() const noexcept { return true; }
+        void await_suspend(std::coroutine_handle<>) const noexcept {}
+        size_t await_resume() const noexcept { return size; }
+    };
+    
+    size_t fill(char* buffer, size_t size) {
+        auto chunkSize = std::min({size, maxChunkSize, input.size()});
+        if (splitAt > 0) {
+            chunkSize = std::min(chunkSize, splitAt);
+            splitAt -= chunkSize;
+        }
+        std::copy(input.begin(), input.begin() + chunkSize, buffer);
+        input.remove_prefix(chunkSize);
+        return chunkSize;
+    }
+    
+    ReadAwaiter read(char* buffer, size_t size) { return ReadAwaiter{fill(buffer, size)}; }
+};
+
+// Completes every read on another thread, the way an event loop would
+struct ThreadedMockReader {
+    MockReader source;
+    std::mutex threadsMutex;
+    std::vector<std::thread> threads;
+    
+    struct ReadAwaiter {
+        ThreadedMockReader& reader;
+        char* buffer;
+        size_t size;
+        size_t result;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(reader.threadsMutex);
+            reader.threads.emplace_back([this, handle]() {
+                result = reader.source.fill(buffer, size);
+                handle.resume();
+            });
+        }
+        size_t await_resume() const noexcept { return result; }
+    };
+    
+    ReadAwaiter read(char* buffer, size_t size) { return ReadAwaiter{*this, buffer, size, 0}; }
+    
+    ~ThreadedMockReader() {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+Task<size_t> countAges(AsyncGenerator<JSONValue> records) {
+    size_t totalAge = 0;
+    while (auto record = co_await records.next()) {
+        totalAge += record->getObject().getValue("age").getInteger();
+    }
+    co_return totalAge;
+}
+
+void asyncParsing() {
+    MockReader reader{sampleRecord, 7, 0};
+    const auto value = syncWait(asyncParse(reader, 16));
+    cout<< "Async parse matches: "<< (BinaryEncoder::encode(value) == BinaryEncoder::encode(Parser::parse(sampleRecord)))<< "\n";
+    
+    const std::string records = std::string(sampleRecord) + "\n" + sampleRecord + "\n" + sampleRecord + "\n";
+    ThreadedMockReader threadedReader{MockReader{records, 100, 0}, {}, {}};
+    cout<< "Async NDJSON total age: "<< syncWait(countAges(asyncRecords(threadedReader, 64)))<< "\n";
+    
+    MockReader truncatedReader{std::string_view(sampleRecord).substr(0, 50), 7, 0};
+    try {
+        syncWait(asyncParse(truncatedReader));
+        cout<< "Async truncated input accepted\n";
+    } catch (const std::exception& e) {
+        cout<< "Async truncated input rejected: "<< e.what()<< "\n";
+    }
+}
+
+bool asyncParseMatches(const std::string& input, size_t maxChunkSize, size_t splitAt) {
+    MockReader reader{input, maxChunkSize, splitAt};
+    try {
+        const auto value = syncWait(asyncParse(reader, 1));
+        return BinaryEncoder::encode(value) == BinaryEncoder::encode(Parser::parseValue(input));
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+void asyncParseAcrossReads() {
+    size_t byteReadMatches = 0;
+    size_t splits = 0;
+    size_t splitMatches = 0;
+    for (const auto fixture : streamingFixtures) {
+        const std::string input = fixture;
+        byteReadMatches += asyncParseMatches(input, 1, 0);
+        for (size_t splitAt = 1; splitAt < input.size(); ++splitAt, ++splits) {
+            splitMatches += asyncParseMatches(input, input.size(), splitAt);
+        }
+    }
+    cout<< "Async 1 byte reads match: "<< byteReadMatches<< " of "<< std::size(streamingFixtures)
+        << ", split reads match: "<< splitMatches<< " of "<< splits<< "\n";
+}
+
+// Input after a stray token should not be waited for, nor buffered
+void asyncRejectEarly() {
+    std::string tail;
+    for (int i = 0; i < 10000; ++i) {
+        tail += "2, ";
+    }
+    tail += "3]";
+    size_t rejectedEarly = 0;
+    const char* const strays[] = {"x", "tx", "-a", "nulL", "1.5.2"};
+    for (const auto stray : strays) {
+        const auto input = "[1, " + std::string(stray) + ", " + tail;
+        MockReader reader{input, 4, 0};
+        try {
+            syncWait(asyncParse(reader, 1));
+        } catch (const std::exception&) {
+            // Reads are 4 bytes, so only a couple of them should follow the stray token
+            rejectedEarly += (input.size() - reader.input.size() <= 16);
+        }
+    }
+    cout<< "Async stray tokens rejected before the end of input: "<< rejectedEarly<< " of "<< std::size(strays)<< "\n";
+}
+#endif
+
 void TestClass::runAllTests() {
     lexString();
     lexEmptyString();
@@ -258,6 +957,35 @@ void TestClass::runAllTests() {
     lexMinusDot();
     lexTwoDotsTogether();
     lexEverything();
+    binaryRoundTrip();
+    binaryInPlaceRead();
+    binaryRejectsGarbage();
+    binaryMappedRead();
+    cacheSharesDocuments();
+    cacheEvictsLeastRecentlyUsed();
+    cacheRefreshesRecency();
+    reparseEdits();
+    reparseIndexedEdits();
+    immutableSnapshots();
+    parallelTraversal();
+    validateInputs();
+    formatDocuments();
+    formatInChunks();
+    formatRejectsEarly();
+    validateAgainstSchema();
+    rejectMalformedSchemas();
+    schemaCountsSurrogatePairs();
+    extractColumns();
+    extractColumnsRejects();
+    lookupByKey();
+    learnShapes();
+    parseWithoutExceptions();
+    parseErrorMessages();
+#ifdef JSONPARSER_HAS_COROUTINES
+    asyncParsing();
+    asyncParseAcrossReads();
+    asyncRejectEarly();
+#endif
 }
 
 static const char alphanum[] =
@@ -332,3 +1060,170 @@ uint64_t LexerTestClass::timeLexer(const int numIter, int numParts) {
     }
     return timeElapsed;
 }
+
+template<typename TFunction>
+static uint64_t timeRepeated(const int numIter, TFunction function) {
+    uint64_t timeElapsed = 0;
+    for (int i = 0; i < numIter; ++i) {
+        auto startTime = std::chrono::steady_clock::now();
+        function();
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        timeElapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+    return timeElapsed;
+}
+
+uint64_t BinaryTestClass::timeTextParse(const int numIter, int numRecords) {
+    const auto input = generateRecords(numRecords);
+    return timeRepeated(numIter, [&]() {
+        auto object = Parser::parse(input);
+        assert(object.exists("records"));
+    });
+}
+
+uint64_t BinaryTestClass::timeBinaryEncode(const int numIter, int numRecords) {
+    const auto object = Parser::parse(generateRecords(numRecords));
+    return timeRepeated(numIter, [&]() {
+        auto encoded = BinaryEncoder::encode(object);
+        assert(!encoded.empty());
+    });
+}
+
+uint64_t BinaryTestClass::timeBinaryDecode(const int numIter, int numRecords) {
+    const auto encoded = BinaryEncoder::encode(Parser::parse(generateRecords(numRecords)));
+    return timeRepeated(numIter, [&]() {
+        auto value = BinaryValue::root(encoded).toJSONValue();
+        assert(value.isObject());
+    });
+}
+
+uint64_t BinaryTestClass::timeBinaryInPlaceRead(const int numIter, int numRecords) {
+    const auto encoded = BinaryEncoder::encode(Parser::parse(generateRecords(numRecords)));
+    return timeRepeated(numIter, [&]() {
+        auto records = BinaryValue::root(encoded).getValue("records");
+        auto age = records[records.size() - 1].getValue("age").getInteger();
+        assert(age == 40);
+    });
+}
+
+uint64_t ValidatorTestClass::timeValidate(const int numIter, int numRecords) {
+    const auto input = generateRecords(numRecords);
+    return timeRepeated(numIter, [&]() {
+        auto result = Validator::validate(input);
+        assert(result.valid);
+    });
+}
+
+uint64_t FormatterTestClass::timeMinify(const int numIter, int numRecords) {
+    const auto input = generateRecords(numRecords);
+    return timeRepeated(numIter, [&]() {
+        auto output = Formatter::minify(input);
+        assert(output.size() < input.size());
+    });
+}
+
+uint64_t SchemaTestClass::timeSchemaParse(const int numIter, int numRecords) {
+    const auto input = generateRecords(numRecords);
+    const auto schema = CompiledSchema::compile(std::string("{\"type\": \"object\", \"required\": [\"records\"], \"properties\": {"
+        "\"records\": {\"type\": \"array\", \"items\": ") + recordSchema + "}}}");
+    return timeRepeated(numIter, [&]() {
+        auto result = SchemaParser::parse(input, schema);
+        assert(result.valid());
+    });
+}
+
+uint64_t ColumnarTestClass::timeParseAndCopy(const int numIter, int numRecords) {
+    const auto input = generateNDJSON(numRecords);
+    return timeRepeated(numIter, [&]() {
+        std::vector<uint64_t> ages;
+        std::vector<double> latitudes;
+        std::vector<bool> isActive;
+        std::vector<std::string> balances;
+        size_t begin = 0;
+        for (auto end = input.find('\n'); end != std::string::npos; begin = end + 1, end = input.find('\n', begin)) {
+            const auto record = Parser::parse(input.substr(begin, end - begin));
+            ages.push_back(record.getValue("age").getInteger());
+            latitudes.push_back(record.getValue("latitude").getDouble());
+            isActive.push_back(record.getValue("isActive").getBool());
+            balances.push_back(record.getValue("balance").getString());
+        }
+        assert(ages.size() == static_cast<size_t>(numRecords));
+    });
+}
+
+uint64_t ColumnarTestClass::timeExtract(const int numIter, int numRecords) {
+    const auto input = generateNDJSON(numRecords);
+    return timeRepeated(numIter, [&]() {
+        ColumnarExtractor extractor({
+            {"age", ColumnType::Int64},
+            {"latitude", ColumnType::Double},
+            {"isActive", ColumnType::Bool},
+            {"balance", ColumnType::String}
+        });
+        extractor.append(input);
+        assert(extractor.numRows() == static_cast<size_t>(numRecords));
+    });
+}
+
+uint64_t KeyTestClass::timeStringLookup(const int numIter) {
+    const auto object = Parser::parse(sampleRecord);
+    uint64_t total = 0;
+    const auto elapsed = timeRepeated(1, [&]() {
+        for (int i = 0; i < numIter; ++i) {
+            total += object.exists("name");
+            total += object.getValue("age").getInteger();
+        }
+    });
+    assert(total == 41 * static_cast<uint64_t>(numIter));
+    return elapsed;
+}
+
+uint64_t KeyTestClass::timeKeyLookup(const int numIter) {
+    const auto object = Parser::parse(sampleRecord);
+    uint64_t total = 0;
+    const auto elapsed = timeRepeated(1, [&]() {
+        for (int i = 0; i < numIter; ++i) {
+            total += object.exists(nameKey);
+            total += object.getValue(ageKey).getInteger();
+        }
+    });
+    assert(total == 41 * static_cast<uint64_t>(numIter));
+    return elapsed;
+}
+
+uint64_t ShapeTestClass::timeShapeParse(const int numIter, int numRecords) {
+    const auto input = generateRecords(numRecords);
+    ShapeCache cache;
+    return timeRepeated(numIter, [&]() {
+        auto object = ShapeParser::parse(input, cache);
+        assert(object.exists("records"));
+    });
+}
+
+static const char malformedRecord[] = "{\"name\": \"Felicia Kirk\", \"age\": 40 \"isActive\": false}";
+
+uint64_t RejectionTestClass::timeThrowingRejection(const int numIter) {
+    size_t rejected = 0;
+    const auto elapsed = timeRepeated(1, [&]() {
+        for (int i = 0; i < numIter; ++i) {
+            try {
+                Parser::parse(malformedRecord);
+            } catch (const std::invalid_argument&) {
+                ++rejected;
+            }
+        }
+    });
+    assert(rejected == static_cast<size_t>(numIter));
+    return elapsed;
+}
+
+uint64_t RejectionTestClass::timeErrorCodeRejection(const int numIter) {
+    size_t rejected = 0;
+    const auto elapsed = timeRepeated(1, [&]() {
+        for (int i = 0; i < numIter; ++i) {
+            rejected += !Parser::tryParse(malformedRecord);
+        }
+    });
+    assert(rejected == static_cast<size_t>(numIter));
+    return elapsed;
+}
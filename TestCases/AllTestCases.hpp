@@ -22,4 +22,57 @@ public:
     static uint64_t timeLexer(const int numIter, int numParts);
 };
 
+// Each returns the total time in ns to handle a document of numRecords records numIter times
+class BinaryTestClass {
+public:
+    static uint64_t timeTextParse(const int numIter, int numRecords);
+    static uint64_t timeBinaryEncode(const int numIter, int numRecords);
+    static uint64_t timeBinaryDecode(const int numIter, int numRecords);
+    static uint64_t timeBinaryInPlaceRead(const int numIter, int numRecords);
+};
+
+// Compare with BinaryTestClass::timeTextParse for the cost of building the tree
+class ValidatorTestClass {
+public:
+    static uint64_t timeValidate(const int numIter, int numRecords);
+};
+
+class FormatterTestClass {
+public:
+    static uint64_t timeMinify(const int numIter, int numRecords);
+};
+
+// Parses and checks a schema in one pass, compare with BinaryTestClass::timeTextParse
+class SchemaTestClass {
+public:
+    static uint64_t timeSchemaParse(const int numIter, int numRecords);
+};
+
+// Fill age, latitude, isActive and balance columns from NDJSON records
+class ColumnarTestClass {
+public:
+    static uint64_t timeParseAndCopy(const int numIter, int numRecords);
+    static uint64_t timeExtract(const int numIter, int numRecords);
+};
+
+// Each returns the total time in ns for numIter iterations of two member lookups on the same object
+class KeyTestClass {
+public:
+    static uint64_t timeStringLookup(const int numIter);
+    static uint64_t timeKeyLookup(const int numIter);
+};
+
+// Compare with BinaryTestClass::timeTextParse; the records share one shape
+class ShapeTestClass {
+public:
+    static uint64_t timeShapeParse(const int numIter, int numRecords);
+};
+
+// Each returns the total time in ns to reject the same malformed record numIter times
+class RejectionTestClass {
+public:
+    static uint64_t timeThrowingRejection(const int numIter);
+    static uint64_t timeErrorCodeRejection(const int numIter);
+};
+
 #endif /* AllTestCases_h */